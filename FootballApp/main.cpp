@@ -1,53 +1,60 @@
 #include <iostream>
+#include <sstream>
 #include <vector>
 #include <string>
 #include <map>
 #include <iomanip>
 #include <algorithm>
+#include <limits>
+#include <cctype>
+#include <atomic>
+#include <csignal>
 #include "../FootballLib/DataTypes.h"
 #include "../FootballLib/Team.h"
 #include "../FootballLib/DataLoader.h"
 #include "../FootballLib/Match.h"
+#include "../FootballLib/PredictionServer.h"
 
 // NEW: Function to display Head-to-Head statistics
-void displayH2HStats(const H2HStats& h2h, const std::string& homeTeam, const std::string& awayTeam) {
+void displayH2HStats(const H2HStats& h2h, const std::string& homeTeam, const std::string& awayTeam,
+                     std::ostream& out = std::cout) {
     if (h2h.totalMatches == 0) {
-        std::cout << "\n--- Head-to-Head History ---" << std::endl;
-        std::cout << "No previous matches found between these teams." << std::endl;
+        out << "\n--- Head-to-Head History ---" << std::endl;
+        out << "No previous matches found between these teams." << std::endl;
         return;
     }
     
-    std::cout << "\n--- Head-to-Head History (Last " << h2h.totalMatches << " matches) ---" << std::endl;
-    std::cout << std::fixed << std::setprecision(1);
+    out << "\n--- Head-to-Head History (Last " << h2h.totalMatches << " matches) ---" << std::endl;
+    out << std::fixed << std::setprecision(1);
     
     // Win percentages
     double homeWinPct = (static_cast<double>(h2h.homeTeamWins) / h2h.totalMatches) * 100.0;
     double drawPct = (static_cast<double>(h2h.draws) / h2h.totalMatches) * 100.0;
     double awayWinPct = (static_cast<double>(h2h.awayTeamWins) / h2h.totalMatches) * 100.0;
     
-    std::cout << homeTeam << " Wins: " << h2h.homeTeamWins 
+    out << homeTeam << " Wins: " << h2h.homeTeamWins 
               << " (" << homeWinPct << "%)" << std::endl;
-    std::cout << "Draws: " << h2h.draws 
+    out << "Draws: " << h2h.draws 
               << " (" << drawPct << "%)" << std::endl;
-    std::cout << awayTeam << " Wins: " << h2h.awayTeamWins 
+    out << awayTeam << " Wins: " << h2h.awayTeamWins 
               << " (" << awayWinPct << "%)" << std::endl;
     
     // Goal averages
-    std::cout << "\nAverage Goals in H2H:" << std::endl;
-    std::cout << "  " << homeTeam << ": " << h2h.avgHomeGoals << std::endl;
-    std::cout << "  " << awayTeam << ": " << h2h.avgAwayGoals << std::endl;
-    std::cout << "  Total per game: " << (h2h.avgHomeGoals + h2h.avgAwayGoals) << std::endl;
+    out << "\nAverage Goals in H2H:" << std::endl;
+    out << "  " << homeTeam << ": " << h2h.avgHomeGoals << std::endl;
+    out << "  " << awayTeam << ": " << h2h.avgAwayGoals << std::endl;
+    out << "  Total per game: " << (h2h.avgHomeGoals + h2h.avgAwayGoals) << std::endl;
     
     // Market stats
-    std::cout << "\nHistorical H2H Market Stats:" << std::endl;
-    std::cout << "  Both Teams To Score: " << h2h.bttsPercentage << "%" << std::endl;
-    std::cout << "  Over 2.5 Goals: " << h2h.over25Percentage << "%" << std::endl;
+    out << "\nHistorical H2H Market Stats:" << std::endl;
+    out << "  Both Teams To Score: " << h2h.bttsPercentage << "%" << std::endl;
+    out << "  Over 2.5 Goals: " << h2h.over25Percentage << "%" << std::endl;
     
     // Recent matches
-    std::cout << "\nRecent H2H Results (most recent first):" << std::endl;
+    out << "\nRecent H2H Results (most recent first):" << std::endl;
     for (size_t i = 0; i < h2h.recentH2H.size() && i < 5; i++) {
         const auto& match = h2h.recentH2H[i];
-        std::cout << "  " << match.dateStr << ": " 
+        out << "  " << match.dateStr << ": " 
                   << match.homeTeamName << " " << match.homeGoals 
                   << "-" << match.awayGoals << " " 
                   << match.awayTeamName << std::endl;
@@ -57,48 +64,108 @@ void displayH2HStats(const H2HStats& h2h, const std::string& homeTeam, const std
 // Updated predictMatch function
 void predictMatch(Match& match, const Team& home, const Team& away,
                   double avgHomeGoals, double avgAwayGoals,
-                  double avgHomeCorners, double avgAwayCorners) {
-    std::cout << "\nSimulating 10,000 matches..." << std::endl;
+                  double avgHomeCorners, double avgAwayCorners, std::ostream& out = std::cout) {
+    out << "\nSimulating 10,000 matches..." << std::endl;
     match.runFullSimulation(home, away, avgHomeGoals, avgAwayGoals, avgHomeCorners, avgAwayCorners);
     
-    std::cout << "\n--- PREDICTION: " << home.name << " vs. " << away.name << " ---" << std::endl;
-    std::cout << std::fixed << std::setprecision(1);
+    out << "\n--- PREDICTION: " << home.name << " vs. " << away.name << " ---" << std::endl;
+    out << std::fixed << std::setprecision(1);
     
     // --- Win/Draw/Loss ---
-    std::cout << home.name << " Win: " << match.getHomeWinPercent() << "%" << std::endl;
-    std::cout << "Draw: " << match.getDrawPercent() << "%" << std::endl;
-    std::cout << away.name << " Win: " << match.getAwayWinPercent() << "%" << std::endl;
+    out << home.name << " Win: " << match.getHomeWinPercent() << "%" << std::endl;
+    out << "Draw: " << match.getDrawPercent() << "%" << std::endl;
+    out << away.name << " Win: " << match.getAwayWinPercent() << "%" << std::endl;
     
     // --- Goal Totals ---
-    std::cout << "\n--- Goal Totals (Over/Under) ---" << std::endl;
-    std::cout << "  Over 0.5: " << match.getOver05Percent() << "%" << std::endl;
-    std::cout << "  Over 1.5: " << match.getOver15Percent() << "%" << std::endl;
-    std::cout << "  Over 2.5: " << match.getOver25Percent() << "%" << std::endl;
+    out << "\n--- Goal Totals (Over/Under) ---" << std::endl;
+    out << "  Over 0.5: " << match.getOver05Percent() << "%" << std::endl;
+    out << "  Over 1.5: " << match.getOver15Percent() << "%" << std::endl;
+    out << "  Over 2.5: " << match.getOver25Percent() << "%" << std::endl;
     
     // --- Both Teams To Score ---
-    std::cout << "\n--- Both Teams To Score ---" << std::endl;
-    std::cout << "  Yes (BTTS): " << match.getBttsYesPercent() << "%" << std::endl;
-    std::cout << "  No: " << match.getBttsNoPercent() << "%" << std::endl;
+    out << "\n--- Both Teams To Score ---" << std::endl;
+    out << "  Yes (BTTS): " << match.getBttsYesPercent() << "%" << std::endl;
+    out << "  No: " << match.getBttsNoPercent() << "%" << std::endl;
     
     // --- Corner Totals ---
-    std::cout << "\n--- Corner Totals (Over/Under) ---" << std::endl;
-    std::cout << "  Average Total Corners: " << match.getAverageTotalCorners() << std::endl;
-    std::cout << "  Over 2.5 Corners: " << match.getCornerPercent(2.5, true) << "%" << std::endl;
-    std::cout << "  Over 4.5 Corners: " << match.getCornerPercent(4.5, true) << "%" << std::endl;
-    std::cout << "  Over 6.5 Corners: " << match.getCornerPercent(6.5, true) << "%" << std::endl;
-    std::cout << "  Over 8.5 Corners: " << match.getCornerPercent(8.5, true) << "%" << std::endl;
-    std::cout << "  Over 10.5 Corners: " << match.getCornerPercent(10.5, true) << "%" << std::endl;
+    out << "\n--- Corner Totals (Over/Under) ---" << std::endl;
+    out << "  Average Total Corners: " << match.getAverageTotalCorners() << std::endl;
+    out << "  Over 2.5 Corners: " << match.getCornerPercent(2.5, true) << "%" << std::endl;
+    out << "  Over 4.5 Corners: " << match.getCornerPercent(4.5, true) << "%" << std::endl;
+    out << "  Over 6.5 Corners: " << match.getCornerPercent(6.5, true) << "%" << std::endl;
+    out << "  Over 8.5 Corners: " << match.getCornerPercent(8.5, true) << "%" << std::endl;
+    out << "  Over 10.5 Corners: " << match.getCornerPercent(10.5, true) << "%" << std::endl;
     
     // --- Most Likely Scores ---
-    std::cout << "\n--- Most Likely Scores ---" << std::endl;
+    out << "\n--- Most Likely Scores ---" << std::endl;
     auto topScores = match.getMostLikelyScores();
     for (const auto& score : topScores) {
-        std::cout << "  " << score.first << ": " << score.second << "%" << std::endl;
+        out << "  " << score.first << ": " << score.second << "%" << std::endl;
     }
 }
 
+// Server that SIGINT/SIGTERM should drain and stop, if one is running
+std::atomic<PredictionServer*> runningServer{nullptr};
+
+extern "C" void handleStopSignal(int) {
+    PredictionServer* server = runningServer.load();
+    if (server) server->requestStop();
+}
+
+void setStopSignalHandler(void (*handler)(int)) {
+    struct sigaction action {};
+    action.sa_handler = handler;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+}
+
+// Positive whole number for a command-line option; false on anything else
+bool parseCountArg(const std::string& text, size_t& value) {
+    if (text.empty() || !std::all_of(text.begin(), text.end(), ::isdigit)) return false;
+    try {
+        value = std::stoul(text);
+    } catch (const std::exception& e) {
+        return false; // Out of range
+    }
+    return value > 0 && value <= std::numeric_limits<unsigned>::max();
+}
+
 // --- main function ---
-int main() {
+// Usage: predictor_app                      interactive menu
+//        predictor_app --serve [--socket <path>] [--workers <n>] [--batch <n>]
+//        (without --socket the server speaks the line protocol on stdin/stdout)
+int main(int argc, char* argv[]) {
+    bool serverMode = false;
+    std::string socketPath;
+    unsigned workerCount = 0;
+    size_t maxBatchSize = 64;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--serve") serverMode = true;
+        else if (arg == "--socket" && i + 1 < argc) socketPath = argv[++i];
+        else if ((arg == "--workers" || arg == "--batch") && i + 1 < argc) {
+            size_t value = 0;
+            if (!parseCountArg(argv[++i], value)) {
+                std::cerr << "Invalid value for " << arg << ": " << argv[i] << " (expected a positive number)" << std::endl;
+                std::cerr << "Usage: predictor_app --serve [--socket <path>] [--workers <n>] [--batch <n>]" << std::endl;
+                return 1;
+            }
+            if (arg == "--workers") workerCount = static_cast<unsigned>(value);
+            else maxBatchSize = value;
+        }
+        else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    // In stdio server mode stdout carries replies only, so load (and reload)
+    // progress goes to stderr for the whole run
+    std::streambuf* coutBuffer = std::cout.rdbuf();
+    bool stdioServer = serverMode && socketPath.empty();
+    if (stdioServer) std::cout.rdbuf(std::cerr.rdbuf());
+
     DataLoader loader;
     
     // --- UPDATED: Define all data files with your names ---
@@ -118,9 +185,30 @@ int main() {
     if (!loader.loadFixtures("FootballApp/fixtures.csv")) {
         std::cerr << "Warning: Could not load fixtures.csv. Continuing without fixture list." << std::endl;
     }
+
+    if (serverMode) {
+        PredictionServer server(loader, workerCount, maxBatchSize);
+        // SIGINT/SIGTERM answer what is already queued (and unlink the socket) before exiting
+        runningServer = &server;
+        setStopSignalHandler(handleStopSignal);
+
+        bool served = true;
+        if (stdioServer) {
+            std::ostream replies(coutBuffer);
+            server.serveStdio(replies);
+            std::cout.rdbuf(coutBuffer);
+        } else {
+            served = server.serveUnixSocket(socketPath);
+        }
+
+        setStopSignalHandler(SIG_DFL);
+        runningServer = nullptr;
+        return served ? 0 : 1;
+    }
     
-    std::map<std::string, Team> overallTeams = loader.getTeams();
-    std::vector<Fixture> allFixtures = loader.getUpcomingFixtures();
+    // Read teams and fixtures in place from one snapshot instead of copying them
+    std::shared_ptr<const ModelSnapshot> model = loader.snapshot();
+    const std::vector<Fixture>& allFixtures = model->upcomingFixtures;
     
     Match match;
     std::string choice;
@@ -139,10 +227,10 @@ int main() {
             std::cout << "Enter Match Date (dd/mm/yyyy): ";
             std::getline(std::cin, dateStr);
             
-            std::vector<Fixture> matchesOnDate;
+            std::vector<const Fixture*> matchesOnDate;
             for(const auto& fix : allFixtures) {
                 if (fix.dateStr == dateStr) { 
-                    matchesOnDate.push_back(fix); 
+                    matchesOnDate.push_back(&fix); 
                 }
             }
             
@@ -154,20 +242,18 @@ int main() {
             
             std::cout << "\nFound " << matchesOnDate.size() << " match(es) on " << dateStr << ". Predicting using form:" << std::endl;
             
-            std::map<std::string, Team> formTeams = loader.calculateFormStrengths(dateStr);
-            if (formTeams.empty()) { 
-                std::cout << "Error calculating form strengths for date " << dateStr << ". Invalid date?" << std::endl; 
-                continue; 
-            }
-            
-            for (const auto& fixture : matchesOnDate) {
-                if (formTeams.count(fixture.homeTeamName) && formTeams.count(fixture.awayTeamName)) {
+            for (const Fixture* fixturePtr : matchesOnDate) {
+                const Fixture& fixture = *fixturePtr;
+                Team homeForm, awayForm;
+                const LeagueModel* league = model->leagueFor(fixture);
+                if (league && loader.calculatePairForm(*league, dateStr, fixture.homeTeamName, fixture.awayTeamName, homeForm, awayForm)) {
                     std::cout << "\n========================================" << std::endl;
                     std::cout << "=== Predicting: " << fixture.homeTeamName << " vs " << fixture.awayTeamName << " ===" << std::endl;
                     std::cout << "========================================" << std::endl;
                     
                     // NEW: Get and display Head-to-Head stats
                     H2HStats h2h = loader.getHeadToHeadStats(
+                        *league,
                         fixture.homeTeamName, 
                         fixture.awayTeamName, 
                         dateStr,  // Only use matches before this date
@@ -176,9 +262,9 @@ int main() {
                     displayH2HStats(h2h, fixture.homeTeamName, fixture.awayTeamName);
                     
                     // Then show the prediction
-                    predictMatch(match, formTeams[fixture.homeTeamName], formTeams[fixture.awayTeamName],
-                                loader.getLeagueAvgHomeGoals(), loader.getLeagueAvgAwayGoals(),
-                                loader.getLeagueAvgHomeCorners(), loader.getLeagueAvgAwayCorners());
+                    predictMatch(match, homeForm, awayForm,
+                                league->leagueAvgHomeGoalsScored, league->leagueAvgAwayGoalsScored,
+                                league->leagueAvgHomeCorners, league->leagueAvgAwayCorners);
                 } else {
                     std::cout << "\nSkipping: " << fixture.homeTeamName << " vs " << fixture.awayTeamName 
                               << " - team not found after form calculation." << std::endl;
@@ -194,32 +280,62 @@ int main() {
             
             std::cout << "\n--- Predicting All Fixtures from fixtures.csv (using Form) ---" << std::endl;
             
+            // Leagues are predicted concurrently, each into its own buffer,
+            // then printed in division order (file order within a division)
+            std::map<std::string, std::vector<const Fixture*>> fixturesByDivision;
             for (const auto& fixture : allFixtures) {
-                std::map<std::string, Team> formTeams = loader.calculateFormStrengths(fixture.dateStr);
-                
-                if (formTeams.empty() || !formTeams.count(fixture.homeTeamName) || !formTeams.count(fixture.awayTeamName)) {
+                const LeagueModel* league = model->leagueFor(fixture);
+                if (league) {
+                    fixturesByDivision[league->division].push_back(&fixture);
+                } else {
                     std::cout << "Skipping: " << fixture.homeTeamName << " vs " << fixture.awayTeamName 
                               << " - team not found or no form data." << std::endl;
-                } else {
-                    std::cout << "\n========================================" << std::endl;
-                    std::cout << "=== " << fixture.dateStr << ": " << fixture.homeTeamName << " vs " << fixture.awayTeamName << " ===" << std::endl;
-                    std::cout << "========================================" << std::endl;
-                    
-                    // NEW: Get and display Head-to-Head stats
-                    H2HStats h2h = loader.getHeadToHeadStats(
-                        fixture.homeTeamName, 
-                        fixture.awayTeamName, 
-                        fixture.dateStr,
-                        10
-                    );
-                    displayH2HStats(h2h, fixture.homeTeamName, fixture.awayTeamName);
-                    
-                    std::cout << "\n--- Using Form Strengths (Last 5 Games before " << fixture.dateStr << ") ---" << std::endl;
-                    predictMatch(match, formTeams[fixture.homeTeamName], formTeams[fixture.awayTeamName],
-                                loader.getLeagueAvgHomeGoals(), loader.getLeagueAvgAwayGoals(),
-                                loader.getLeagueAvgHomeCorners(), loader.getLeagueAvgAwayCorners());
+                    std::cout << "------------------------------------" << std::endl;
                 }
-                std::cout << "------------------------------------" << std::endl;
+            }
+            
+            std::map<std::string, std::string> reports;
+            for (const auto& pair : fixturesByDivision) reports[pair.first]; // Filled by one task each
+            
+            DataLoader::forEachLeague(*model, [&](const LeagueModel& league) {
+                auto fixtures = fixturesByDivision.find(league.division);
+                if (fixtures == fixturesByDivision.end()) return;
+                
+                Match leagueMatch; // Match keeps per-run state, so one per task
+                std::ostringstream out;
+                for (const Fixture* fixture : fixtures->second) {
+                    Team homeForm, awayForm;
+                    if (!loader.calculatePairForm(league, fixture->dateStr, fixture->homeTeamName, fixture->awayTeamName, homeForm, awayForm)) {
+                        out << "Skipping: " << fixture->homeTeamName << " vs " << fixture->awayTeamName 
+                            << " - team not found or no form data." << std::endl;
+                    } else {
+                        out << "\n========================================" << std::endl;
+                        out << "=== " << fixture->dateStr << ": " << fixture->homeTeamName << " vs " << fixture->awayTeamName << " ===" << std::endl;
+                        out << "========================================" << std::endl;
+                        
+                        // NEW: Get and display Head-to-Head stats
+                        H2HStats h2h = loader.getHeadToHeadStats(
+                            league,
+                            fixture->homeTeamName, 
+                            fixture->awayTeamName, 
+                            fixture->dateStr,
+                            10
+                        );
+                        displayH2HStats(h2h, fixture->homeTeamName, fixture->awayTeamName, out);
+                        
+                        out << "\n--- Using Form Strengths (Last 5 Games before " << fixture->dateStr << ") ---" << std::endl;
+                        predictMatch(leagueMatch, homeForm, awayForm,
+                                    league.leagueAvgHomeGoalsScored, league.leagueAvgAwayGoalsScored,
+                                    league.leagueAvgHomeCorners, league.leagueAvgAwayCorners, out);
+                    }
+                    out << "------------------------------------" << std::endl;
+                }
+                reports.at(league.division) = out.str();
+            });
+            
+            for (const auto& pair : reports) {
+                if (fixturesByDivision.size() > 1) std::cout << "\n##### Division " << pair.first << " #####" << std::endl;
+                std::cout << pair.second;
             }
         }
         else if (!choice.empty() && choice[0] == '3') {
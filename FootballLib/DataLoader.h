@@ -11,8 +11,16 @@
 #include <iomanip>
 #include <chrono>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <set>
+#include <cctype>
 #include "DataTypes.h"
 #include "Team.h"
+#include "RatingEngine.h"
 
 // Struct for temporary raw stats
 struct TeamData {
@@ -23,8 +31,11 @@ struct TeamData {
     int homeCornersAgainst = 0, awayCornersAgainst = 0;
 };
 
-class DataLoader {
-private:
+// Everything loaded for one division (the CSV Div column, e.g. "T1"): league
+// averages, teams with their history and strengths, ratings and calibration.
+struct LeagueModel {
+    std::string division;
+
     // NEW: Four distinct league averages
     double leagueAvgHomeGoalsScored = 0.0;
     double leagueAvgAwayGoalsScored = 0.0;
@@ -33,88 +44,158 @@ private:
     double leagueAvgHomeCorners = 0.0;
     double leagueAvgAwayCorners = 0.0;
 
-    std::vector<Fixture> upcomingFixtures;
     std::map<std::string, Team> loadedTeams;
+    RatingEngine ratings; // Per-team rating timelines over this league's results
+    InPlayCalibration inPlay;
+    int matchCount = 0;
+
+    // Raw sums behind the averages and all-time strengths, kept so
+    // DataLoader::appendResult can update them without rescanning history
+    std::map<std::string, TeamData> rawData;
+    int totalHomeGoals = 0, totalAwayGoals = 0;
+    int totalHomeCorners = 0, totalAwayCorners = 0;
+    std::chrono::system_clock::time_point lastResultDate; // Newest result loaded
+
+    // Read-only lookups that hand out references into the snapshot; they stay
+    // valid for as long as the caller holds the snapshot pointer.
+    const Team* findTeam(const std::string& teamName) const {
+        auto it = loadedTeams.find(teamName);
+        return it == loadedTeams.end() ? nullptr : &it->second;
+    }
+
+    const std::vector<MatchResult>& getMatchHistory(const std::string& teamName) const {
+        static const std::vector<MatchResult> noHistory;
+        const Team* team = findTeam(teamName);
+        return team ? team->matchHistory : noHistory;
+    }
+};
+
+// Immutable view of everything loaded: one LeagueModel per division plus the
+// upcoming fixtures. A snapshot is never modified after it is published, so
+// readers can use it without locking.
+struct ModelSnapshot {
+    // By division. Leagues are immutable and shared, so a snapshot that only
+    // changes fixtures reuses them instead of copying histories and ratings.
+    std::map<std::string, std::shared_ptr<const LeagueModel>> leagues;
+    std::vector<Fixture> upcomingFixtures;      // All divisions
+
+    const LeagueModel* findLeague(const std::string& division) const {
+        auto it = leagues.find(division);
+        return it == leagues.end() ? nullptr : it->second.get();
+    }
+
+    // Division that has a team of this name (and 'otherTeam', when set). A
+    // promoted or relegated side appears in two, so the one holding the team's
+    // most recent result wins. nullptr if none matches or no single division
+    // wins; 'ambiguous' tells the two apart.
+    const LeagueModel* leagueOfTeam(const std::string& teamName, const std::string& otherTeam = "",
+                                    bool* ambiguous = nullptr) const {
+        const LeagueModel* best = nullptr;
+        auto bestDate = std::chrono::system_clock::time_point::min();
+        bool tied = false;
+        for (const auto& pair : leagues) {
+            const Team* team = pair.second->findTeam(teamName);
+            if (!team || (!otherTeam.empty() && !pair.second->findTeam(otherTeam))) continue;
+
+            auto lastPlayed = team->matchHistory.empty() ? std::chrono::system_clock::time_point::min()
+                                                         : team->matchHistory.back().date;
+            if (!best || lastPlayed > bestDate) {
+                best = pair.second.get();
+                bestDate = lastPlayed;
+                tied = false;
+            } else if (lastPlayed == bestDate) {
+                tied = true;
+            }
+        }
+        if (ambiguous) *ambiguous = tied;
+        return tied ? nullptr : best;
+    }
+
+    // The fixture's own division, or the one holding both teams when
+    // fixtures.csv has no Div column
+    const LeagueModel* leagueFor(const Fixture& fixture) const {
+        if (!fixture.division.empty()) return findLeague(fixture.division);
+        return leagueOfTeam(fixture.homeTeamName, fixture.awayTeamName);
+    }
+
+    // Used by the convenience getters: the named division, or the only one
+    // loaded when 'division' is empty. nullptr when the division is unknown, or
+    // when it is empty and several are loaded, since picking one would be a guess.
+    const LeagueModel* resolveLeague(const std::string& division) const {
+        if (!division.empty()) return findLeague(division);
+        return leagues.size() == 1 ? leagues.begin()->second.get() : nullptr;
+    }
+};
+
+class DataLoader {
+private:
+    // Current model. Loads build a new snapshot off to the side and publish it
+    // with std::atomic_store, so an in-flight prediction keeps the snapshot it
+    // started with. libstdc++ implements atomic_load/atomic_store on shared_ptr
+    // with a small pool of mutexes, so snapshot() only goes through
+    // atomic_load when 'currentVersion' shows that a new model was published.
+    std::shared_ptr<const ModelSnapshot> current = std::make_shared<const ModelSnapshot>();
+    std::atomic<uint64_t> currentVersion{nextVersion()};
+    std::vector<std::string> resultFiles; // Remembered for reload()
+    mutable std::mutex writerMutex;       // Serializes loads; readers never take it
 
 public:
     // --- NEW: Load data from multiple files ---
+    // Rows are partitioned by the Div column, and each division is built into
+    // its own LeagueModel. Files are parsed in parallel, then leagues are built
+    // in parallel.
     bool loadMultipleFiles(const std::vector<std::string>& filePaths) {
-        loadedTeams.clear();
-        std::vector<MatchResult> allResults;
-        std::map<std::string, TeamData> rawData;
-        int totalHomeGoals = 0, totalAwayGoals = 0, totalMatches = 0;
-        int totalHomeCorners = 0, totalAwayCorners = 0;
+        std::lock_guard<std::mutex> writerLock(writerMutex);
 
-        // Loop through each results file
+        std::vector<std::future<ParsedFile>> parsing;
         for (const std::string& filePath : filePaths) {
-            std::ifstream file(filePath);
-            if (!file.is_open()) {
-                std::cerr << "Warning: Could not open stats file: " << filePath << std::endl;
+            parsing.push_back(std::async(std::launch::async, [this, filePath] { return parseResultsFile(filePath); }));
+        }
+
+        // Merge per-file rows by division; report in file order
+        std::map<std::string, LeagueRows> rowsByDivision;
+        for (size_t i = 0; i < parsing.size(); ++i) {
+            ParsedFile parsed = parsing[i].get();
+            if (!parsed.opened) {
+                std::cerr << "Warning: Could not open stats file: " << filePaths[i] << std::endl;
                 continue; // Skip this file if it can't be opened
             }
+            std::cout << "Processing file: " << filePaths[i] << "..." << std::endl;
+            for (auto& pair : parsed.divisions) {
+                LeagueRows& rows = rowsByDivision[pair.first];
+                rows.teamNames.insert(pair.second.teamNames.begin(), pair.second.teamNames.end());
+                rows.results.insert(rows.results.end(),
+                                    std::make_move_iterator(pair.second.results.begin()),
+                                    std::make_move_iterator(pair.second.results.end()));
+            }
+        }
 
-            std::cout << "Processing file: " << filePath << "..." << std::endl;
-            std::string line;
-            std::getline(file, line); // Skip header
-
-            while (std::getline(file, line)) {
-                if (line.empty() || line.find(',') == std::string::npos) continue;
-
-                std::stringstream ss(line);
-                std::string cell;
-                std::vector<std::string> row;
-                while (std::getline(ss, cell, ',')) { row.push_back(cell); }
-
-                // Need at least 19 columns for basic data + corners (HC, AC)
-                if (row.size() < 19) continue;
-
-                try {
-                    std::string dateStr = row[1];
-                    std::string homeTeamName = row[3];
-                    std::string awayTeamName = row[4];
-                    if (homeTeamName.empty() || awayTeamName.empty()) continue;
-
-                    auto matchDate = parseDate(dateStr);
-                    if (matchDate == std::chrono::system_clock::from_time_t(0)) continue;
-
-                    // Ensure team objects exist
-                    if (loadedTeams.find(homeTeamName) == loadedTeams.end()) { loadedTeams[homeTeamName] = Team(homeTeamName); }
-                    if (loadedTeams.find(awayTeamName) == loadedTeams.end()) { loadedTeams[awayTeamName] = Team(awayTeamName); }
-
-                    // Check score columns (only process completed games for stats)
-                    if (!row[5].empty() && !row[6].empty() && isdigit(row[5][0]) && isdigit(row[6][0])) {
-                        int homeGoals = std::stoi(row[5]); 
-                        int awayGoals = std::stoi(row[6]);
-                        int homeCorners = 0, awayCorners = 0;
-                        if (!row[17].empty()) try { homeCorners = std::stoi(row[17]); } catch (...) {}
-                        if (!row[18].empty()) try { awayCorners = std::stoi(row[18]); } catch (...) {}
-
-                        MatchResult result = {dateStr, matchDate, homeTeamName, awayTeamName, homeGoals, awayGoals};
-                        allResults.push_back(result);
-
-                        // Accumulate raw data
-                        rawData[homeTeamName].homeMatches++;
-                        rawData[homeTeamName].homeGoalsScored += homeGoals;
-                        rawData[homeTeamName].homeGoalsConceded += awayGoals;
-                        rawData[homeTeamName].homeCornersFor += homeCorners;
-                        rawData[homeTeamName].homeCornersAgainst += awayCorners;
-
-                        rawData[awayTeamName].awayMatches++;
-                        rawData[awayTeamName].awayGoalsScored += awayGoals;
-                        rawData[awayTeamName].awayGoalsConceded += homeGoals;
-                        rawData[awayTeamName].awayCornersFor += awayCorners;
-                        rawData[awayTeamName].awayCornersAgainst += homeCorners;
-
-                        totalHomeGoals += homeGoals;
-                        totalAwayGoals += awayGoals;
-                        totalHomeCorners += homeCorners;
-                        totalAwayCorners += awayCorners;
-                        totalMatches++;
-                    }
-                } catch (const std::exception& e) { /* Skip bad lines */ }
+        // Build every division independently
+        std::vector<std::string> divisions;
+        std::vector<LeagueModel> built(rowsByDivision.size());
+        std::vector<std::future<void>> building;
+        for (auto& pair : rowsByDivision) {
+            size_t index = divisions.size();
+            divisions.push_back(pair.first);
+            LeagueRows* rows = &pair.second;
+            building.push_back(std::async(std::launch::async, [&built, index, rows, division = pair.first] {
+                buildLeague(division, *rows, built[index]);
+            }));
+        }
+        for (auto& future : building) future.get();
+
+        // Build into a fresh snapshot; fixtures carry over from the current one
+        auto next = std::make_shared<ModelSnapshot>();
+        next->upcomingFixtures = std::atomic_load(&current)->upcomingFixtures; // Not snapshot(), which would pin it in this thread's cache
+        int totalMatches = 0;
+        for (size_t i = 0; i < built.size(); ++i) {
+            if (built[i].matchCount == 0) {
+                std::cerr << "Warning: No completed matches for division " << divisions[i] << ", skipping it." << std::endl;
+                continue;
             }
-            file.close();
-        } // End loop through files
+            totalMatches += built[i].matchCount;
+            next->leagues.emplace(divisions[i], std::make_shared<const LeagueModel>(std::move(built[i])));
+        }
 
         if (totalMatches == 0) {
             std::cerr << "Error: No completed matches found in any data file." << std::endl;
@@ -122,49 +203,114 @@ public:
         }
 
         std::cout << "Total historical matches processed: " << totalMatches << std::endl;
+        if (next->leagues.size() > 1) {
+            for (const auto& pair : next->leagues) {
+                std::cout << "  " << pair.first << ": " << pair.second->matchCount << " matches, "
+                          << pair.second->loadedTeams.size() << " teams" << std::endl;
+            }
+        }
 
-        // --- Calculate NEW League Averages ---
-        leagueAvgHomeGoalsScored = static_cast<double>(totalHomeGoals) / totalMatches;
-        leagueAvgAwayGoalsScored = static_cast<double>(totalAwayGoals) / totalMatches;
+        resultFiles = filePaths;
+        publish(std::move(next));
+        return true;
+    }
 
-        // Average goals conceded by home team = average scored by away team
-        leagueAvgHomeGoalsConceded = leagueAvgAwayGoalsScored;
-        // Average goals conceded by away team = average scored by home team
-        leagueAvgAwayGoalsConceded = leagueAvgHomeGoalsScored;
+    // Runs fn(const LeagueModel&) for every division concurrently and waits for
+    // all of them, e.g. for batch prediction or backtests across leagues.
+    template <typename Fn>
+    static void forEachLeague(const ModelSnapshot& model, Fn fn) {
+        std::vector<std::future<void>> running;
+        for (const auto& pair : model.leagues) {
+            const LeagueModel* league = pair.second.get();
+            running.push_back(std::async(std::launch::async, [&fn, league] { fn(*league); }));
+        }
+        for (auto& future : running) future.get();
+    }
 
-        leagueAvgHomeCorners = static_cast<double>(totalHomeCorners) / totalMatches;
-        leagueAvgAwayCorners = static_cast<double>(totalAwayCorners) / totalMatches;
+    // Adds one completed match to 'division' without rebuilding: only that
+    // league is copied, its averages and all-time strengths are updated from
+    // the raw sums, the ratings take the result in O(1) (still scaled by the
+    // averages of the last full build), and a new snapshot sharing every other
+    // league is published. result.date is parsed from
+    // result.dateStr. The result must not be older than the league's latest
+    // one and both teams must already be loaded; otherwise reload() the files.
+    // In-play calibration is left as it was built. Nothing is written to disk,
+    // so a later reload() drops the result unless it was also added to a file.
+    bool appendResult(const std::string& division, MatchResult result, int homeCorners, int awayCorners) {
+        result.date = parseDate(result.dateStr);
+        if (result.date == std::chrono::system_clock::from_time_t(0)) {
+            std::cerr << "Error: Invalid result date: " << result.dateStr << std::endl;
+            return false;
+        }
 
-        // Add history and calculate overall strengths using NEW averages
-        std::sort(allResults.begin(), allResults.end(), [](const MatchResult& a, const MatchResult& b) { return a.date < b.date; });
+        std::lock_guard<std::mutex> writerLock(writerMutex);
+        std::shared_ptr<const ModelSnapshot> model = std::atomic_load(&current);
+        const LeagueModel* existing = model->findLeague(division);
+        if (!existing) {
+            std::cerr << "Error: Unknown division: " << division << std::endl;
+            return false;
+        }
+        if (result.homeTeamName == result.awayTeamName || !existing->findTeam(result.homeTeamName) ||
+            !existing->findTeam(result.awayTeamName)) {
+            std::cerr << "Error: Result needs two different teams of division " << division << std::endl;
+            return false;
+        }
+        if (result.date < existing->lastResultDate) {
+            std::cerr << "Error: Result of " << result.dateStr << " is older than the latest one loaded" << std::endl;
+            return false;
+        }
 
-        for (auto& pair : loadedTeams) {
-            std::string teamName = pair.first;
-            Team& team = pair.second;
+        auto league = std::make_shared<LeagueModel>(*existing);
+        addRawResult(*league, result, homeCorners, awayCorners);
+        league->loadedTeams[result.homeTeamName].matchHistory.push_back(result);
+        league->loadedTeams[result.awayTeamName].matchHistory.push_back(result);
+        league->ratings.addResult(result);
+        calculateStrengths(*league);
 
-            // Add all historical matches for this team
-            for(const auto& result : allResults) {
-                if (result.homeTeamName == teamName || result.awayTeamName == teamName) {
-                    team.matchHistory.push_back(result);
-                }
-            }
+        auto next = std::make_shared<ModelSnapshot>(*model);
+        next->leagues[division] = std::move(league);
+        publish(std::move(next));
+        return true;
+    }
 
-            // Calculate overall (all-time) strengths
-            const TeamData& data = rawData[teamName];
-            if (data.homeMatches > 0) {
-                team.homeAttackStrength = (static_cast<double>(data.homeGoalsScored) / data.homeMatches) / leagueAvgHomeGoalsScored;
-                team.homeDefenseStrength = (static_cast<double>(data.homeGoalsConceded) / data.homeMatches) / leagueAvgHomeGoalsConceded;
-                team.homeCornerAttackStrength = (static_cast<double>(data.homeCornersFor) / data.homeMatches) / leagueAvgHomeCorners;
-                team.homeCornerDefenseStrength = (static_cast<double>(data.homeCornersAgainst) / data.homeMatches) / leagueAvgAwayCorners; // Defend against away corners
-            }
-            if (data.awayMatches > 0) {
-                team.awayAttackStrength = (static_cast<double>(data.awayGoalsScored) / data.awayMatches) / leagueAvgAwayGoalsScored;
-                team.awayDefenseStrength = (static_cast<double>(data.awayGoalsConceded) / data.awayMatches) / leagueAvgAwayGoalsConceded;
-                team.awayCornerAttackStrength = (static_cast<double>(data.awayCornersFor) / data.awayMatches) / leagueAvgAwayCorners;
-                team.awayCornerDefenseStrength = (static_cast<double>(data.awayCornersAgainst) / data.awayMatches) / leagueAvgHomeCorners; // Defend against home corners
-            }
+    // Re-reads the result files from the last successful load and swaps in the
+    // new model. Readers keep working on the old snapshot until they finish.
+    bool reload() {
+        std::vector<std::string> filePaths;
+        {
+            std::lock_guard<std::mutex> writerLock(writerMutex);
+            filePaths = resultFiles;
         }
-        return true;
+        if (filePaths.empty()) {
+            std::cerr << "Error: Nothing to reload, no result files loaded yet." << std::endl;
+            return false;
+        }
+        return loadMultipleFiles(filePaths);
+    }
+
+    // Current model; hold on to the returned pointer to get a consistent view
+    // across several queries. Each thread caches the last snapshot it took,
+    // so while nothing is reloading this is one atomic load and a refcount
+    // increment, without touching the mutex behind std::atomic_load. A cached
+    // snapshot stays alive until that thread calls snapshot() again or
+    // releaseCachedSnapshot(); long-lived threads should call the latter
+    // before going idle so a retired model isn't kept around.
+    std::shared_ptr<const ModelSnapshot> snapshot() const {
+        CachedSnapshot& cached = threadCache();
+        uint64_t version = currentVersion.load(std::memory_order_acquire);
+        if (cached.version != version) {
+            // 'current' is stored before its version, so this is at least as new as 'version'
+            cached.model = std::atomic_load(&current);
+            cached.version = version;
+        }
+        return cached.model;
+    }
+
+    // Drops this thread's cached snapshot; the next snapshot() call refetches
+    static void releaseCachedSnapshot() {
+        CachedSnapshot& cached = threadCache();
+        cached.model.reset();
+        cached.version = 0;
     }
 
     // --- THIS FUNCTION IS NO LONGER USED, but we leave it to avoid errors ---
@@ -177,13 +323,13 @@ public:
 
     // --- Fixture Loading --- FIXED: NO HEADER SKIP
     bool loadFixtures(const std::string& filePath) {
-        upcomingFixtures.clear();
         std::ifstream file(filePath);
         if (!file.is_open()) {
             std::cerr << "Error: Could not open fixtures file: " << filePath << std::endl;
             return false;
         }
         
+        std::vector<Fixture> upcomingFixtures;
         std::string line;
         // FIXED: Removed header skip since fixtures.csv has no header
         
@@ -193,14 +339,41 @@ public:
             std::vector<std::string> row;
             while (std::getline(ss, cell, ',')) { row.push_back(cell); }
             if (row.size() < 3) continue;
-            upcomingFixtures.push_back(Fixture{row[0], row[1], row[2]});
+            // Either date,home,away or Div,date,home,away; without a Div column
+            // the division is the one holding both teams (ModelSnapshot::leagueFor)
+            if (row.size() >= 4) {
+                row[0].erase(std::remove_if(row[0].begin(), row[0].end(), ::isspace), row[0].end());
+                upcomingFixtures.push_back(Fixture{row[1], row[2], row[3], row[0]});
+            } else {
+                upcomingFixtures.push_back(Fixture{row[0], row[1], row[2], ""});
+            }
         }
         file.close();
-        return !upcomingFixtures.empty();
+
+        // Leagues are shared with the current model by pointer; only fixtures change
+        std::lock_guard<std::mutex> writerLock(writerMutex);
+        auto next = std::make_shared<ModelSnapshot>();
+        next->leagues = std::atomic_load(&current)->leagues;
+        next->upcomingFixtures = std::move(upcomingFixtures);
+        bool loaded = !next->upcomingFixtures.empty();
+        publish(std::move(next));
+        return loaded;
     }
 
     // --- Form Calculation ---
-    std::map<std::string, Team> calculateFormStrengths(const std::string& fixtureDateStr, int formMatches = 5) {
+    // Form strengths for every team of 'division'; may be empty when only one is loaded
+    std::map<std::string, Team> calculateFormStrengths(const std::string& fixtureDateStr, int formMatches = 5,
+                                                       const std::string& division = "") const {
+        std::shared_ptr<const ModelSnapshot> model = snapshot();
+        const LeagueModel* league = requireLeague(*model, division);
+        if (!league) return {};
+        return calculateFormStrengths(*league, fixtureDateStr, formMatches);
+    }
+
+    // Form strengths for every team. Prefer calculatePairForm when only the two
+    // sides of one fixture are needed.
+    std::map<std::string, Team> calculateFormStrengths(const LeagueModel& model,
+                                                       const std::string& fixtureDateStr, int formMatches = 5) const {
         auto fixtureDate = parseDate(fixtureDateStr);
         if (fixtureDate == std::chrono::system_clock::from_time_t(0)) {
             std::cerr << "Error: Invalid fixture date for form calculation: " << fixtureDateStr << std::endl;
@@ -208,74 +381,98 @@ public:
         }
 
         std::map<std::string, Team> formTeams;
-        std::map<std::string, TeamData> rawData;
-
-        // Use a copy of all loaded teams (which have their full history)
-        for (const auto& pair : loadedTeams) {
-            const std::string& teamName = pair.first;
-            const Team& overallTeam = pair.second;
-            formTeams[teamName] = Team(teamName); // Create new team for form stats
-
-            int homeMatches = 0, awayMatches = 0;
-
-            // Iterate history backwards to find last 'formMatches'
-            for (auto it = overallTeam.matchHistory.rbegin(); it != overallTeam.matchHistory.rend(); ++it) {
-                const MatchResult& result = *it;
-
-                // Only use matches *before* the fixture date
-                if (result.date >= fixtureDate) continue;
-
-                if (result.homeTeamName == teamName && homeMatches < formMatches) {
-                    rawData[teamName].homeMatches++;
-                    rawData[teamName].homeGoalsScored += result.homeGoals;
-                    rawData[teamName].homeGoalsConceded += result.awayGoals;
-                    homeMatches++;
-                } else if (result.awayTeamName == teamName && awayMatches < formMatches) {
-                    rawData[teamName].awayMatches++;
-                    rawData[teamName].awayGoalsScored += result.awayGoals;
-                    rawData[teamName].awayGoalsConceded += result.homeGoals;
-                    awayMatches++;
-                }
-                if (homeMatches >= formMatches && awayMatches >= formMatches) break;
-            }
+        for (const auto& pair : model.loadedTeams) {
+            formTeams.emplace_hint(formTeams.end(), pair.first, buildTeamForm(model, pair.second, fixtureDate, formMatches));
         }
+        return formTeams;
+    }
 
-        // Calculate form strengths based on raw data
-        for (auto& pair : formTeams) {
-            std::string teamName = pair.first;
-            Team& team = pair.second;
-            const TeamData& data = rawData[teamName];
+    // --- NEW: Form for a single team / a single fixture ---
+    // Only the requested teams' histories are scanned. The returned Team objects
+    // carry strengths only; their matchHistory is left empty.
+    bool calculateTeamForm(const LeagueModel& model, const std::string& teamName,
+                           const std::string& fixtureDateStr, Team& form, int formMatches = 5) const {
+        const Team* overallTeam = model.findTeam(teamName);
+        if (!overallTeam) return false;
 
-            // Use league averages calculated from *all* historical data
-            if (data.homeMatches > 0) {
-                team.homeAttackStrength = (static_cast<double>(data.homeGoalsScored) / data.homeMatches) / leagueAvgHomeGoalsScored;
-                team.homeDefenseStrength = (static_cast<double>(data.homeGoalsConceded) / data.homeMatches) / leagueAvgHomeGoalsConceded;
-            } else { // No recent home games, use overall strength as fallback
-                team.homeAttackStrength = loadedTeams[teamName].homeAttackStrength;
-                team.homeDefenseStrength = loadedTeams[teamName].homeDefenseStrength;
-            }
-            if (data.awayMatches > 0) {
-                team.awayAttackStrength = (static_cast<double>(data.awayGoalsScored) / data.awayMatches) / leagueAvgAwayGoalsScored;
-                team.awayDefenseStrength = (static_cast<double>(data.awayGoalsConceded) / data.awayMatches) / leagueAvgAwayGoalsConceded;
-            } else { // No recent away games, use overall strength as fallback
-                team.awayAttackStrength = loadedTeams[teamName].awayAttackStrength;
-                team.awayDefenseStrength = loadedTeams[teamName].awayDefenseStrength;
-            }
+        auto fixtureDate = parseDate(fixtureDateStr);
+        if (fixtureDate == std::chrono::system_clock::from_time_t(0)) {
+            std::cerr << "Error: Invalid fixture date for form calculation: " << fixtureDateStr << std::endl;
+            return false;
+        }
+        form = buildTeamForm(model, *overallTeam, fixtureDate, formMatches);
+        return true;
+    }
+
+    bool calculatePairForm(const LeagueModel& model, const std::string& fixtureDateStr,
+                           const std::string& homeTeam, const std::string& awayTeam,
+                           Team& homeForm, Team& awayForm, int formMatches = 5) const {
+        const Team* home = model.findTeam(homeTeam);
+        const Team* away = model.findTeam(awayTeam);
+        if (!home || !away) return false;
 
-            // NOTE: Form for corners is not calculated, we'll use overall corner strength
-            team.homeCornerAttackStrength = loadedTeams[teamName].homeCornerAttackStrength;
-            team.homeCornerDefenseStrength = loadedTeams[teamName].homeCornerDefenseStrength;
-            team.awayCornerAttackStrength = loadedTeams[teamName].awayCornerAttackStrength;
-            team.awayCornerDefenseStrength = loadedTeams[teamName].awayCornerDefenseStrength;
+        auto fixtureDate = parseDate(fixtureDateStr);
+        if (fixtureDate == std::chrono::system_clock::from_time_t(0)) {
+            std::cerr << "Error: Invalid fixture date for form calculation: " << fixtureDateStr << std::endl;
+            return false;
         }
-        return formTeams;
+        homeForm = buildTeamForm(model, *home, fixtureDate, formMatches);
+        awayForm = buildTeamForm(model, *away, fixtureDate, formMatches);
+        return true;
+    }
+
+    // --- NEW: Rating-based strengths ---
+    // Alternative to form: goal strengths from the rating ladder as of the
+    // fixture date (a binary search, no history scan). Corner strengths and
+    // teams with no earlier result fall back to the overall strengths.
+    bool calculateRatingStrengths(const LeagueModel& model, const std::string& teamName,
+                                  const std::string& fixtureDateStr, Team& strengths) const {
+        const Team* overallTeam = model.findTeam(teamName);
+        if (!overallTeam) return false;
+
+        auto fixtureDate = parseDate(fixtureDateStr);
+        if (fixtureDate == std::chrono::system_clock::from_time_t(0)) {
+            std::cerr << "Error: Invalid fixture date for rating lookup: " << fixtureDateStr << std::endl;
+            return false;
+        }
+
+        strengths = Team(teamName);
+        strengths.homeAttackStrength = overallTeam->homeAttackStrength;
+        strengths.homeDefenseStrength = overallTeam->homeDefenseStrength;
+        strengths.awayAttackStrength = overallTeam->awayAttackStrength;
+        strengths.awayDefenseStrength = overallTeam->awayDefenseStrength;
+        strengths.homeCornerAttackStrength = overallTeam->homeCornerAttackStrength;
+        strengths.homeCornerDefenseStrength = overallTeam->homeCornerDefenseStrength;
+        strengths.awayCornerAttackStrength = overallTeam->awayCornerAttackStrength;
+        strengths.awayCornerDefenseStrength = overallTeam->awayCornerDefenseStrength;
+        model.ratings.applyStrengths(teamName, fixtureDate, strengths);
+        return true;
+    }
+
+    // Ratings after the team's last match before the date; nullptr if none
+    const RatingPoint* getRatingBefore(const LeagueModel& model, const std::string& teamName,
+                                       const std::string& dateStr) const {
+        auto date = parseDate(dateStr);
+        if (date == std::chrono::system_clock::from_time_t(0)) return nullptr;
+        return model.ratings.ratingBefore(teamName, date);
     }
 
     // --- NEW: Head-to-Head Analysis ---
     H2HStats getHeadToHeadStats(const std::string& homeTeam, 
                                 const std::string& awayTeam, 
                                 const std::string& beforeDate = "",
-                                int maxMatches = 10) {
+                                int maxMatches = 10) const {
+        std::shared_ptr<const ModelSnapshot> model = snapshot();
+        const LeagueModel* league = model->leagueOfTeam(homeTeam, awayTeam);
+        if (!league) return H2HStats();
+        return getHeadToHeadStats(*league, homeTeam, awayTeam, beforeDate, maxMatches);
+    }
+
+    H2HStats getHeadToHeadStats(const LeagueModel& model,
+                                const std::string& homeTeam, 
+                                const std::string& awayTeam, 
+                                const std::string& beforeDate = "",
+                                int maxMatches = 10) const {
         H2HStats stats;
         
         auto cutoffDate = std::chrono::system_clock::time_point::max();
@@ -284,12 +481,12 @@ public:
         }
         
         // Check if teams exist
-        if (loadedTeams.find(homeTeam) == loadedTeams.end() || 
-            loadedTeams.find(awayTeam) == loadedTeams.end()) {
+        const Team* homeSide = model.findTeam(homeTeam);
+        if (!homeSide || !model.findTeam(awayTeam)) {
             return stats;
         }
         
-        const Team& team = loadedTeams[homeTeam];
+        const Team& team = *homeSide;
         int totalGoalsHome = 0, totalGoalsAway = 0;
         int bttsCount = 0, over25Count = 0;
         
@@ -359,17 +556,339 @@ public:
     }
 
     // --- Getters ---
-    std::map<std::string, Team> getTeams() const { return loadedTeams; }
-    std::vector<Fixture> getUpcomingFixtures() const { return upcomingFixtures; }
+    // Each getter reads the current snapshot. getTeams and getUpcomingFixtures
+    // copy everything, histories included; hold a snapshot() and read its
+    // members by const reference instead on any hot path. League getters take
+    // a division code, which may only be left empty while a single division is
+    // loaded; otherwise they report an error and return an empty map or 0.
+    std::map<std::string, Team> getTeams(const std::string& division = "") const {
+        std::shared_ptr<const ModelSnapshot> model = snapshot();
+        const LeagueModel* league = requireLeague(*model, division);
+        return league ? league->loadedTeams : std::map<std::string, Team>();
+    }
+    std::vector<Fixture> getUpcomingFixtures() const { return snapshot()->upcomingFixtures; }
+
+    std::vector<std::string> getDivisions() const {
+        std::vector<std::string> divisions;
+        for (const auto& pair : snapshot()->leagues) divisions.push_back(pair.first);
+        return divisions;
+    }
 
     // NEW: Pass the correct averages
-    double getLeagueAvgHomeGoals() const { return leagueAvgHomeGoalsScored; }
-    double getLeagueAvgAwayGoals() const { return leagueAvgAwayGoalsScored; }
-    double getLeagueAvgHomeCorners() const { return leagueAvgHomeCorners; }
-    double getLeagueAvgAwayCorners() const { return leagueAvgAwayCorners; }
+    double getLeagueAvgHomeGoals(const std::string& division = "") const { return leagueValue(division, &LeagueModel::leagueAvgHomeGoalsScored); }
+    double getLeagueAvgAwayGoals(const std::string& division = "") const { return leagueValue(division, &LeagueModel::leagueAvgAwayGoalsScored); }
+    double getLeagueAvgHomeCorners(const std::string& division = "") const { return leagueValue(division, &LeagueModel::leagueAvgHomeCorners); }
+    double getLeagueAvgAwayCorners(const std::string& division = "") const { return leagueValue(division, &LeagueModel::leagueAvgAwayCorners); }
 
 private:
-    std::chrono::system_clock::time_point parseDate(const std::string& dateStr) {
+    struct CachedSnapshot {
+        uint64_t version = 0;
+        std::shared_ptr<const ModelSnapshot> model;
+    };
+
+    // Versions are unique across loaders, so one cache per thread is enough
+    static CachedSnapshot& threadCache() {
+        thread_local CachedSnapshot cached;
+        return cached;
+    }
+
+    // Process-wide, so a version never identifies snapshots of two loaders
+    static uint64_t nextVersion() {
+        static std::atomic<uint64_t> counter{0};
+        return ++counter;
+    }
+
+    // Caller holds writerMutex
+    void publish(std::shared_ptr<ModelSnapshot> next) {
+        std::atomic_store(&current, std::shared_ptr<const ModelSnapshot>(std::move(next)));
+        currentVersion.store(nextVersion(), std::memory_order_release);
+    }
+
+    double leagueValue(const std::string& division, double LeagueModel::*field) const {
+        std::shared_ptr<const ModelSnapshot> model = snapshot();
+        const LeagueModel* league = requireLeague(*model, division);
+        return league ? league->*field : 0.0;
+    }
+
+    // ModelSnapshot::resolveLeague, reporting why it found nothing
+    static const LeagueModel* requireLeague(const ModelSnapshot& model, const std::string& division) {
+        const LeagueModel* league = model.resolveLeague(division);
+        if (league) return league;
+        if (!division.empty()) {
+            std::cerr << "Error: Unknown division: " << division << std::endl;
+        } else if (model.leagues.size() > 1) {
+            std::cerr << "Error: " << model.leagues.size() << " divisions are loaded, pass one of them" << std::endl;
+        }
+        return nullptr;
+    }
+
+    // One completed match plus the extra columns used for calibration
+    struct ResultRow {
+        MatchResult result;
+        int homeCorners = 0, awayCorners = 0;
+        int homeHalfTimeGoals = -1, awayHalfTimeGoals = -1; // -1 when HTHG/HTAG missing
+        int homeRedCards = -1, awayRedCards = -1;           // -1 when HR/AR missing
+    };
+
+    struct LeagueRows {
+        std::vector<ResultRow> results;
+        std::set<std::string> teamNames; // Includes teams from not-yet-played rows
+    };
+
+    struct ParsedFile {
+        bool opened = false;
+        std::map<std::string, LeagueRows> divisions;
+    };
+
+    ParsedFile parseResultsFile(const std::string& filePath) const {
+        ParsedFile parsed;
+        std::ifstream file(filePath);
+        if (!file.is_open()) return parsed;
+        parsed.opened = true;
+
+        std::string line;
+        std::getline(file, line); // Skip header
+
+        while (std::getline(file, line)) {
+            if (line.empty() || line.find(',') == std::string::npos) continue;
+
+            std::stringstream ss(line);
+            std::string cell;
+            std::vector<std::string> row;
+            while (std::getline(ss, cell, ',')) { row.push_back(cell); }
+
+            // Need at least 19 columns for basic data + corners (HC, AC)
+            if (row.size() < 19) continue;
+
+            try {
+                std::string division = row[0];
+                division.erase(std::remove_if(division.begin(), division.end(), ::isspace), division.end());
+                std::string dateStr = row[1];
+                std::string homeTeamName = row[3];
+                std::string awayTeamName = row[4];
+                if (homeTeamName.empty() || awayTeamName.empty()) continue;
+
+                auto matchDate = parseDate(dateStr);
+                if (matchDate == std::chrono::system_clock::from_time_t(0)) continue;
+
+                // Ensure team objects exist
+                LeagueRows& league = parsed.divisions[division];
+                league.teamNames.insert(homeTeamName);
+                league.teamNames.insert(awayTeamName);
+
+                // Check score columns (only process completed games for stats)
+                if (!row[5].empty() && !row[6].empty() && isdigit(row[5][0]) && isdigit(row[6][0])) {
+                    ResultRow result;
+                    result.result = {dateStr, matchDate, homeTeamName, awayTeamName, std::stoi(row[5]), std::stoi(row[6])};
+                    if (!row[17].empty()) try { result.homeCorners = std::stoi(row[17]); } catch (...) {}
+                    if (!row[18].empty()) try { result.awayCorners = std::stoi(row[18]); } catch (...) {}
+
+                    // Half-time score (HTHG, HTAG) and red cards (HR, AR) when present
+                    if (!row[8].empty() && !row[9].empty() && isdigit(row[8][0]) && isdigit(row[9][0])) {
+                        result.homeHalfTimeGoals = std::stoi(row[8]);
+                        result.awayHalfTimeGoals = std::stoi(row[9]);
+                    }
+                    if (row.size() > 22 && !row[21].empty() && !row[22].empty() &&
+                        isdigit(row[21][0]) && isdigit(row[22][0])) {
+                        result.homeRedCards = std::stoi(row[21]);
+                        result.awayRedCards = std::stoi(row[22]);
+                    }
+                    league.results.push_back(std::move(result));
+                }
+            } catch (const std::exception& e) { /* Skip bad lines */ }
+        }
+        return parsed;
+    }
+
+    // Averages, strengths, histories, ratings and calibration for one division
+    static void buildLeague(const std::string& division, LeagueRows& rows, LeagueModel& model) {
+        model.division = division;
+
+        // In-play calibration: goals split by half
+        int fullHomeGoalsWithHT = 0, fullAwayGoalsWithHT = 0;
+        int firstHalfHomeGoals = 0, firstHalfAwayGoals = 0;
+
+        for (const std::string& teamName : rows.teamNames) { model.loadedTeams.emplace(teamName, Team(teamName)); }
+
+        for (const ResultRow& row : rows.results) {
+            const MatchResult& result = row.result;
+            addRawResult(model, result, row.homeCorners, row.awayCorners);
+
+            if (row.homeHalfTimeGoals >= 0) {
+                firstHalfHomeGoals += row.homeHalfTimeGoals;
+                firstHalfAwayGoals += row.awayHalfTimeGoals;
+                fullHomeGoalsWithHT += result.homeGoals;
+                fullAwayGoalsWithHT += result.awayGoals;
+            }
+        }
+
+        if (model.matchCount == 0) return;
+        calculateStrengths(model);
+
+        // --- In-play calibration ---
+        if (fullHomeGoalsWithHT > 0 && fullAwayGoalsWithHT > 0) {
+            model.inPlay.homeFirstHalfGoalShare = static_cast<double>(firstHalfHomeGoals) / fullHomeGoalsWithHT;
+            model.inPlay.awayFirstHalfGoalShare = static_cast<double>(firstHalfAwayGoals) / fullAwayGoalsWithHT;
+        }
+        // Red-card minutes aren't in the data, so assume on average a card is
+        // shown at half-time: observed/expected = (1 + factor) / 2 for one card.
+        int cardedSides = 0, goalsByCardedSide = 0, goalsAgainstCardedSide = 0;
+        double expectedByCardedSide = 0.0, expectedAgainstCardedSide = 0.0;
+        for (const ResultRow& row : rows.results) {
+            if (row.homeRedCards < 0) continue;
+            const MatchResult& match = row.result;
+            if (row.homeRedCards > row.awayRedCards) {
+                cardedSides++;
+                goalsByCardedSide += match.homeGoals;
+                goalsAgainstCardedSide += match.awayGoals;
+                expectedByCardedSide += model.leagueAvgHomeGoalsScored;
+                expectedAgainstCardedSide += model.leagueAvgAwayGoalsScored;
+            } else if (row.awayRedCards > row.homeRedCards) {
+                cardedSides++;
+                goalsByCardedSide += match.awayGoals;
+                goalsAgainstCardedSide += match.homeGoals;
+                expectedByCardedSide += model.leagueAvgAwayGoalsScored;
+                expectedAgainstCardedSide += model.leagueAvgHomeGoalsScored;
+            }
+        }
+        if (cardedSides >= 30 && expectedByCardedSide > 0.0 && expectedAgainstCardedSide > 0.0) {
+            double ownFactor = 2.0 * goalsByCardedSide / expectedByCardedSide - 1.0;
+            double opponentFactor = 2.0 * goalsAgainstCardedSide / expectedAgainstCardedSide - 1.0;
+            model.inPlay.redCardOwnFactor = std::min(1.0, std::max(0.4, ownFactor));
+            model.inPlay.redCardOpponentFactor = std::min(1.8, std::max(1.0, opponentFactor));
+        }
+
+        // Ratings and per-team history, both in date order
+        std::sort(rows.results.begin(), rows.results.end(),
+                  [](const ResultRow& a, const ResultRow& b) { return a.result.date < b.result.date; });
+        std::vector<MatchResult> allResults;
+        allResults.reserve(rows.results.size());
+        for (const ResultRow& row : rows.results) allResults.push_back(row.result);
+        model.ratings.build(allResults, model.leagueAvgHomeGoalsScored, model.leagueAvgAwayGoalsScored);
+
+        // Add all historical matches for each team in one pass over the sorted table
+        for (const MatchResult& result : allResults) {
+            model.loadedTeams[result.homeTeamName].matchHistory.push_back(result);
+            model.loadedTeams[result.awayTeamName].matchHistory.push_back(result);
+        }
+        model.lastResultDate = allResults.back().date;
+    }
+
+    // Adds one match to the league totals and both teams' raw sums
+    static void addRawResult(LeagueModel& model, const MatchResult& result, int homeCorners, int awayCorners) {
+        TeamData& home = model.rawData[result.homeTeamName];
+        home.homeMatches++;
+        home.homeGoalsScored += result.homeGoals;
+        home.homeGoalsConceded += result.awayGoals;
+        home.homeCornersFor += homeCorners;
+        home.homeCornersAgainst += awayCorners;
+
+        TeamData& away = model.rawData[result.awayTeamName];
+        away.awayMatches++;
+        away.awayGoalsScored += result.awayGoals;
+        away.awayGoalsConceded += result.homeGoals;
+        away.awayCornersFor += awayCorners;
+        away.awayCornersAgainst += homeCorners;
+
+        model.totalHomeGoals += result.homeGoals;
+        model.totalAwayGoals += result.awayGoals;
+        model.totalHomeCorners += homeCorners;
+        model.totalAwayCorners += awayCorners;
+        model.matchCount++;
+    }
+
+    // League averages and every team's all-time strengths from the raw sums
+    static void calculateStrengths(LeagueModel& model) {
+        int totalMatches = model.matchCount;
+
+        // --- Calculate NEW League Averages ---
+        model.leagueAvgHomeGoalsScored = static_cast<double>(model.totalHomeGoals) / totalMatches;
+        model.leagueAvgAwayGoalsScored = static_cast<double>(model.totalAwayGoals) / totalMatches;
+
+        // Average goals conceded by home team = average scored by away team
+        model.leagueAvgHomeGoalsConceded = model.leagueAvgAwayGoalsScored;
+        // Average goals conceded by away team = average scored by home team
+        model.leagueAvgAwayGoalsConceded = model.leagueAvgHomeGoalsScored;
+
+        model.leagueAvgHomeCorners = static_cast<double>(model.totalHomeCorners) / totalMatches;
+        model.leagueAvgAwayCorners = static_cast<double>(model.totalAwayCorners) / totalMatches;
+
+        for (auto& pair : model.loadedTeams) {
+            Team& team = pair.second;
+
+            // Calculate overall (all-time) strengths
+            auto raw = model.rawData.find(pair.first);
+            if (raw == model.rawData.end()) continue;
+            const TeamData& data = raw->second;
+            if (data.homeMatches > 0) {
+                team.homeAttackStrength = (static_cast<double>(data.homeGoalsScored) / data.homeMatches) / model.leagueAvgHomeGoalsScored;
+                team.homeDefenseStrength = (static_cast<double>(data.homeGoalsConceded) / data.homeMatches) / model.leagueAvgHomeGoalsConceded;
+                team.homeCornerAttackStrength = (static_cast<double>(data.homeCornersFor) / data.homeMatches) / model.leagueAvgHomeCorners;
+                team.homeCornerDefenseStrength = (static_cast<double>(data.homeCornersAgainst) / data.homeMatches) / model.leagueAvgAwayCorners; // Defend against away corners
+            }
+            if (data.awayMatches > 0) {
+                team.awayAttackStrength = (static_cast<double>(data.awayGoalsScored) / data.awayMatches) / model.leagueAvgAwayGoalsScored;
+                team.awayDefenseStrength = (static_cast<double>(data.awayGoalsConceded) / data.awayMatches) / model.leagueAvgAwayGoalsConceded;
+                team.awayCornerAttackStrength = (static_cast<double>(data.awayCornersFor) / data.awayMatches) / model.leagueAvgAwayCorners;
+                team.awayCornerDefenseStrength = (static_cast<double>(data.awayCornersAgainst) / data.awayMatches) / model.leagueAvgHomeCorners; // Defend against home corners
+            }
+        }
+    }
+
+    // Strengths from one team's last 'formMatches' home and away games before fixtureDate
+    Team buildTeamForm(const LeagueModel& model, const Team& overallTeam,
+                       std::chrono::system_clock::time_point fixtureDate, int formMatches) const {
+        const std::string& teamName = overallTeam.name;
+        Team team(teamName); // Create new team for form stats
+        TeamData data;
+        int homeMatches = 0, awayMatches = 0;
+
+        // Iterate history backwards to find last 'formMatches'
+        for (auto it = overallTeam.matchHistory.rbegin(); it != overallTeam.matchHistory.rend(); ++it) {
+            const MatchResult& result = *it;
+
+            // Only use matches *before* the fixture date
+            if (result.date >= fixtureDate) continue;
+
+            if (result.homeTeamName == teamName && homeMatches < formMatches) {
+                data.homeMatches++;
+                data.homeGoalsScored += result.homeGoals;
+                data.homeGoalsConceded += result.awayGoals;
+                homeMatches++;
+            } else if (result.awayTeamName == teamName && awayMatches < formMatches) {
+                data.awayMatches++;
+                data.awayGoalsScored += result.awayGoals;
+                data.awayGoalsConceded += result.homeGoals;
+                awayMatches++;
+            }
+            if (homeMatches >= formMatches && awayMatches >= formMatches) break;
+        }
+
+        // Use league averages calculated from *all* historical data
+        if (data.homeMatches > 0) {
+            team.homeAttackStrength = (static_cast<double>(data.homeGoalsScored) / data.homeMatches) / model.leagueAvgHomeGoalsScored;
+            team.homeDefenseStrength = (static_cast<double>(data.homeGoalsConceded) / data.homeMatches) / model.leagueAvgHomeGoalsConceded;
+        } else { // No recent home games, use overall strength as fallback
+            team.homeAttackStrength = overallTeam.homeAttackStrength;
+            team.homeDefenseStrength = overallTeam.homeDefenseStrength;
+        }
+        if (data.awayMatches > 0) {
+            team.awayAttackStrength = (static_cast<double>(data.awayGoalsScored) / data.awayMatches) / model.leagueAvgAwayGoalsScored;
+            team.awayDefenseStrength = (static_cast<double>(data.awayGoalsConceded) / data.awayMatches) / model.leagueAvgAwayGoalsConceded;
+        } else { // No recent away games, use overall strength as fallback
+            team.awayAttackStrength = overallTeam.awayAttackStrength;
+            team.awayDefenseStrength = overallTeam.awayDefenseStrength;
+        }
+
+        // NOTE: Form for corners is not calculated, we'll use overall corner strength
+        team.homeCornerAttackStrength = overallTeam.homeCornerAttackStrength;
+        team.homeCornerDefenseStrength = overallTeam.homeCornerDefenseStrength;
+        team.awayCornerAttackStrength = overallTeam.awayCornerAttackStrength;
+        team.awayCornerDefenseStrength = overallTeam.awayCornerDefenseStrength;
+        return team;
+    }
+
+    std::chrono::system_clock::time_point parseDate(const std::string& dateStr) const {
         std::tm tm = {};
         std::stringstream ss(dateStr);
         if (dateStr.find('/') != std::string::npos) {
@@ -386,7 +905,7 @@ private:
         return std::chrono::system_clock::from_time_t(std::mktime(&tm));
     }
 
-    bool isdigit(char c) { return c >= '0' && c <= '9'; }
+    bool isdigit(char c) const { return c >= '0' && c <= '9'; }
 };
 
 #endif // DATALOADER_H
\ No newline at end of file
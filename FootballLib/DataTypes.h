@@ -10,6 +10,7 @@ struct Fixture {
     std::string dateStr;
     std::string homeTeamName;
     std::string awayTeamName;
+    std::string division; // Div code, empty when fixtures.csv has no Div column
 };
 
 // Represents a completed match from the data files
@@ -22,6 +23,14 @@ struct MatchResult {
     int awayGoals;
 };
 
+// NEW: In-play calibration measured from the loaded results
+struct InPlayCalibration {
+    double homeFirstHalfGoalShare = 0.45; // Share of home goals scored before half-time (HTHG / FTHG)
+    double awayFirstHalfGoalShare = 0.45; // Same for away goals (HTAG / FTAG)
+    double redCardOwnFactor = 0.70;       // Scoring rate multiplier per red card for the carded side
+    double redCardOpponentFactor = 1.25;  // Scoring rate multiplier per red card for the other side
+};
+
 // NEW: Head-to-head statistics between two teams
 struct H2HStats {
     int totalMatches = 0;
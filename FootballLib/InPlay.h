@@ -0,0 +1,60 @@
+#ifndef INPLAY_H
+#define INPLAY_H
+
+#include <cmath>
+#include <algorithm>
+#include "DataTypes.h"
+#include "Match.h"        // For MatchLambdas
+#include "MarketEngine.h"
+
+// Live match state at the moment of re-pricing
+struct InPlayState {
+    int minute = 0;                        // Elapsed minutes, 0-90 (stoppage counts as 90)
+    int homeGoals = 0, awayGoals = 0;
+    int homeRedCards = 0, awayRedCards = 0;
+    int homeCorners = 0, awayCorners = 0;
+};
+
+// Re-prices a fixture from its pre-match rates and the live state without any
+// simulation: the pre-match lambdas are scaled down to the time left (goals
+// follow the measured first/second-half split, uniform within each half) and
+// adjusted for red cards, then the MarketEngine adds the remaining-goal
+// distribution on top of the current score.
+class InPlayPricer {
+public:
+    explicit InPlayPricer(const InPlayCalibration& calibration = InPlayCalibration()) : calib(calibration) {}
+
+    MatchLambdas remainingRates(const MatchLambdas& fullMatch, const InPlayState& state) const {
+        double minute = std::min(90.0, std::max(0.0, static_cast<double>(state.minute)));
+
+        MatchLambdas remaining;
+        remaining.homeGoals = fullMatch.homeGoals * remainingShare(calib.homeFirstHalfGoalShare, minute);
+        remaining.awayGoals = fullMatch.awayGoals * remainingShare(calib.awayFirstHalfGoalShare, minute);
+        remaining.homeCorners = fullMatch.homeCorners * (90.0 - minute) / 90.0;
+        remaining.awayCorners = fullMatch.awayCorners * (90.0 - minute) / 90.0;
+
+        // Each red card cuts the carded side's rate and lifts the opponent's for the rest of the match
+        remaining.homeGoals *= std::pow(calib.redCardOwnFactor, state.homeRedCards) *
+                               std::pow(calib.redCardOpponentFactor, state.awayRedCards);
+        remaining.awayGoals *= std::pow(calib.redCardOwnFactor, state.awayRedCards) *
+                               std::pow(calib.redCardOpponentFactor, state.homeRedCards);
+        return remaining;
+    }
+
+    // Rebuild 'engine' for the live state; price any MarketRequest on it afterwards
+    void reprice(const MatchLambdas& fullMatch, const InPlayState& state, MarketEngine& engine) const {
+        engine.buildInPlay(remainingRates(fullMatch, state), state.homeGoals, state.awayGoals,
+                           state.homeCorners, state.awayCorners);
+    }
+
+private:
+    InPlayCalibration calib;
+
+    // Fraction of a side's full-match goal expectation still to come at 'minute'
+    static double remainingShare(double firstHalfShare, double minute) {
+        if (minute < 45.0) return firstHalfShare * (45.0 - minute) / 45.0 + (1.0 - firstHalfShare);
+        return (1.0 - firstHalfShare) * (90.0 - minute) / 45.0;
+    }
+};
+
+#endif // INPLAY_H
@@ -0,0 +1,370 @@
+#ifndef MARKETENGINE_H
+#define MARKETENGINE_H
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include "Team.h"
+#include "Match.h" // For MatchLambdas / Match::expectedRates
+
+// Market families the engine can price
+enum class MarketType {
+    MatchResult,      // 1X2
+    DoubleChance,     // 1X / 12 / X2
+    TotalGoals,       // Over/Under any line, incl. whole and quarter lines
+    HomeTeamGoals,    // Team total, home side
+    AwayTeamGoals,    // Team total, away side
+    BothTeamsToScore,
+    AsianHandicap,    // Line applied to the chosen side, incl. quarter lines
+    WinToNil,
+    CorrectScore,
+    TotalCorners,
+    CornerHandicap
+};
+
+enum class MarketSide { Home, Draw, Away, HomeOrDraw, HomeOrAway, DrawOrAway, Over, Under, Yes, No };
+
+// One market to price, e.g. AsianHandicap/Home/-0.75 or TotalGoals/Over/3.5
+struct MarketRequest {
+    MarketType type = MarketType::MatchResult;
+    MarketSide side = MarketSide::Home;
+    double line = 0.0;
+    int homeScore = 0, awayScore = 0; // CorrectScore only
+    std::string label;                // Spec the request was parsed from
+};
+
+// Settlement probabilities for one market. For quarter lines the stake is split
+// over the two neighbouring half lines and the probabilities are averaged, so
+// fairOdds = (1 - push) / win holds for every line type.
+struct MarketQuote {
+    double win = 0.0;
+    double push = 0.0;
+    double lose = 0.0;
+    double fairOdds = 0.0; // 0 when the outcome is impossible
+};
+
+// Builds the goal and corner distributions for one fixture once, then prices
+// any number of markets against them, each in O(1). Correct scores at or past
+// the per-side goal cap price as zero.
+class MarketEngine {
+public:
+    // Goals/corners beyond these caps are folded into the last bucket
+    void build(const MatchLambdas& rates, int maxGoalsPerSide = 10, int maxCornersPerSide = 25) {
+        buildInPlay(rates, 0, 0, 0, 0, maxGoalsPerSide, maxCornersPerSide);
+    }
+
+    // In-play: 'rates' cover only the time left and are added on top of the
+    // goals and corners so far. Caps apply to what is still to come.
+    void buildInPlay(const MatchLambdas& rates, int homeGoalsSoFar, int awayGoalsSoFar,
+                     int homeCornersSoFar, int awayCornersSoFar,
+                     int maxGoalsPerSide = 10, int maxCornersPerSide = 25) {
+        maxGoals = maxGoalsPerSide;
+        maxCorners = maxCornersPerSide;
+        startHomeGoals = homeGoalsSoFar;
+        startAwayGoals = awayGoalsSoFar;
+
+        std::vector<double> homeGoalsPmf = poissonPmf(rates.homeGoals, maxGoals);
+        std::vector<double> awayGoalsPmf = poissonPmf(rates.awayGoals, maxGoals);
+        std::vector<double> homeCornersPmf = poissonPmf(rates.homeCorners, maxCorners);
+        std::vector<double> awayCornersPmf = poissonPmf(rates.awayCorners, maxCorners);
+
+        // Joint grid of goals still to come and everything derived from it, in one pass
+        const int side = maxGoals + 1;
+        scoreGrid.assign(side * side, 0.0);
+        std::vector<double> totalGoalsPmf(2 * maxGoals + 1, 0.0);
+        std::vector<double> goalDiffPmf(2 * maxGoals + 1, 0.0); // Index = home - away + maxGoals
+        bttsYes = homeWinToNil = awayWinToNil = 0.0;
+        for (int h = 0; h <= maxGoals; ++h) {
+            for (int a = 0; a <= maxGoals; ++a) {
+                double p = homeGoalsPmf[h] * awayGoalsPmf[a];
+                scoreGrid[h * side + a] = p;
+                totalGoalsPmf[h + a] += p;
+                goalDiffPmf[h - a + maxGoals] += p;
+
+                int finalHome = h + homeGoalsSoFar, finalAway = a + awayGoalsSoFar;
+                if (finalHome > 0 && finalAway > 0) bttsYes += p;
+                if (finalAway == 0 && finalHome > 0) homeWinToNil += p;
+                if (finalHome == 0 && finalAway > 0) awayWinToNil += p;
+            }
+        }
+
+        std::vector<double> totalCornersPmf(2 * maxCorners + 1, 0.0);
+        std::vector<double> cornerDiffPmf(2 * maxCorners + 1, 0.0); // Index = home - away + maxCorners
+        for (int h = 0; h <= maxCorners; ++h) {
+            for (int a = 0; a <= maxCorners; ++a) {
+                double p = homeCornersPmf[h] * awayCornersPmf[a];
+                totalCornersPmf[h + a] += p;
+                cornerDiffPmf[h - a + maxCorners] += p;
+            }
+        }
+
+        // Shift each support by what has already happened
+        totalGoals = Cumulative(totalGoalsPmf, homeGoalsSoFar + awayGoalsSoFar);
+        homeGoals = Cumulative(homeGoalsPmf, homeGoalsSoFar);
+        awayGoals = Cumulative(awayGoalsPmf, awayGoalsSoFar);
+        goalDiff = Cumulative(goalDiffPmf, -maxGoals + homeGoalsSoFar - awayGoalsSoFar);
+        totalCorners = Cumulative(totalCornersPmf, homeCornersSoFar + awayCornersSoFar);
+        cornerDiff = Cumulative(cornerDiffPmf, -maxCorners + homeCornersSoFar - awayCornersSoFar);
+    }
+
+    void build(const Team& home, const Team& away,
+               double avgHomeGoals, double avgAwayGoals,
+               double avgHomeCorners, double avgAwayCorners) {
+        build(Match::expectedRates(home, away, avgHomeGoals, avgAwayGoals, avgHomeCorners, avgAwayCorners));
+    }
+
+    MarketQuote price(const MarketRequest& market) const {
+        switch (market.type) {
+            case MarketType::MatchResult: {
+                double home = 1.0 - goalDiff.atMost(0);
+                double away = goalDiff.atMost(-1);
+                double draw = 1.0 - home - away;
+                return outright(market.side == MarketSide::Home ? home : market.side == MarketSide::Away ? away : draw);
+            }
+            case MarketType::DoubleChance: {
+                double home = 1.0 - goalDiff.atMost(0);
+                double away = goalDiff.atMost(-1);
+                double draw = 1.0 - home - away;
+                if (market.side == MarketSide::HomeOrDraw) return outright(home + draw);
+                if (market.side == MarketSide::HomeOrAway) return outright(home + away);
+                return outright(draw + away);
+            }
+            case MarketType::TotalGoals:    return overUnder(totalGoals, market.side, market.line);
+            case MarketType::HomeTeamGoals: return overUnder(homeGoals, market.side, market.line);
+            case MarketType::AwayTeamGoals: return overUnder(awayGoals, market.side, market.line);
+            case MarketType::TotalCorners:  return overUnder(totalCorners, market.side, market.line);
+            case MarketType::BothTeamsToScore:
+                return outright(market.side == MarketSide::No ? 1.0 - bttsYes : bttsYes);
+            case MarketType::AsianHandicap:  return handicap(goalDiff, market.side, market.line);
+            case MarketType::CornerHandicap: return handicap(cornerDiff, market.side, market.line);
+            case MarketType::WinToNil:
+                return outright(market.side == MarketSide::Away ? awayWinToNil : homeWinToNil);
+            case MarketType::CorrectScore: {
+                int h = market.homeScore - startHomeGoals, a = market.awayScore - startAwayGoals;
+                if (h < 0 || a < 0 || h >= maxGoals || a >= maxGoals) return outright(0.0);
+                return outright(scoreGrid[h * (maxGoals + 1) + a]);
+            }
+        }
+        return MarketQuote{};
+    }
+
+    std::vector<MarketQuote> price(const std::vector<MarketRequest>& markets) const {
+        std::vector<MarketQuote> quotes;
+        quotes.reserve(markets.size());
+        for (const MarketRequest& market : markets) quotes.push_back(price(market));
+        return quotes;
+    }
+
+    // Top correct scores as ("h - a", percent), like Match::getMostLikelyScores
+    std::vector<std::pair<std::string, double>> getMostLikelyScores(int topN = 5) const {
+        std::vector<std::pair<double, int>> cells;
+        cells.reserve(scoreGrid.size());
+        for (size_t i = 0; i < scoreGrid.size(); ++i) cells.push_back({scoreGrid[i], static_cast<int>(i)});
+        size_t count = std::min(cells.size(), static_cast<size_t>(std::max(topN, 0)));
+        std::partial_sort(cells.begin(), cells.begin() + count, cells.end(),
+                          [](const std::pair<double, int>& x, const std::pair<double, int>& y) { return x.first > y.first; });
+
+        std::vector<std::pair<std::string, double>> topList;
+        for (size_t i = 0; i < count; ++i) {
+            int h = cells[i].second / (maxGoals + 1) + startHomeGoals;
+            int a = cells[i].second % (maxGoals + 1) + startAwayGoals;
+            topList.push_back({std::to_string(h) + " - " + std::to_string(a), cells[i].first * 100.0});
+        }
+        return topList;
+    }
+
+    // --- Market specs as used on the wire, e.g. "AH_HOME:-0.75" ---
+    //   1X2:H|D|A            DC:1X|12|X2          BTTS:YES|NO        WTN:H|A
+    //   GOALS_OVER:<line>    GOALS_UNDER:<line>   CS:<home>-<away>
+    //   HOME_OVER:<line>     HOME_UNDER:<line>    AWAY_OVER:<line>   AWAY_UNDER:<line>
+    //   AH_HOME:<line>       AH_AWAY:<line>       CORNERS_OVER:<line> CORNERS_UNDER:<line>
+    //   CH_HOME:<line>       CH_AWAY:<line>       (corner handicap)
+    // Lines are quarter multiples with |line| <= maxLine.
+    static constexpr double maxLine = 100.0;
+
+    static bool parseMarket(const std::string& spec, MarketRequest& market) {
+        size_t colon = spec.find(':');
+        if (colon == std::string::npos) return false;
+        std::string name = spec.substr(0, colon);
+        std::string arg = spec.substr(colon + 1);
+        std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+        std::transform(arg.begin(), arg.end(), arg.begin(), ::toupper);
+        market = MarketRequest{};
+        market.label = spec;
+
+        if (name == "1X2") {
+            market.type = MarketType::MatchResult;
+            if (arg == "H") market.side = MarketSide::Home;
+            else if (arg == "D") market.side = MarketSide::Draw;
+            else if (arg == "A") market.side = MarketSide::Away;
+            else return false;
+            return true;
+        }
+        if (name == "DC") {
+            market.type = MarketType::DoubleChance;
+            if (arg == "1X") market.side = MarketSide::HomeOrDraw;
+            else if (arg == "12") market.side = MarketSide::HomeOrAway;
+            else if (arg == "X2") market.side = MarketSide::DrawOrAway;
+            else return false;
+            return true;
+        }
+        if (name == "BTTS") {
+            market.type = MarketType::BothTeamsToScore;
+            if (arg == "YES") market.side = MarketSide::Yes;
+            else if (arg == "NO") market.side = MarketSide::No;
+            else return false;
+            return true;
+        }
+        if (name == "WTN") {
+            market.type = MarketType::WinToNil;
+            if (arg == "H") market.side = MarketSide::Home;
+            else if (arg == "A") market.side = MarketSide::Away;
+            else return false;
+            return true;
+        }
+        if (name == "CS") {
+            market.type = MarketType::CorrectScore;
+            char dash = 0;
+            std::stringstream ss(arg);
+            return static_cast<bool>(ss >> market.homeScore >> dash >> market.awayScore) && dash == '-';
+        }
+
+        struct LineMarket { const char* name; MarketType type; MarketSide side; };
+        static const LineMarket lineMarkets[] = {
+            {"GOALS_OVER", MarketType::TotalGoals, MarketSide::Over},
+            {"GOALS_UNDER", MarketType::TotalGoals, MarketSide::Under},
+            {"HOME_OVER", MarketType::HomeTeamGoals, MarketSide::Over},
+            {"HOME_UNDER", MarketType::HomeTeamGoals, MarketSide::Under},
+            {"AWAY_OVER", MarketType::AwayTeamGoals, MarketSide::Over},
+            {"AWAY_UNDER", MarketType::AwayTeamGoals, MarketSide::Under},
+            {"AH_HOME", MarketType::AsianHandicap, MarketSide::Home},
+            {"AH_AWAY", MarketType::AsianHandicap, MarketSide::Away},
+            {"CORNERS_OVER", MarketType::TotalCorners, MarketSide::Over},
+            {"CORNERS_UNDER", MarketType::TotalCorners, MarketSide::Under},
+            {"CH_HOME", MarketType::CornerHandicap, MarketSide::Home},
+            {"CH_AWAY", MarketType::CornerHandicap, MarketSide::Away},
+        };
+        for (const LineMarket& candidate : lineMarkets) {
+            if (name != candidate.name) continue;
+            market.type = candidate.type;
+            market.side = candidate.side;
+            try {
+                size_t used = 0;
+                market.line = std::stod(arg, &used);
+                if (used != arg.size()) return false;
+            } catch (...) { return false; }
+            if (!(std::fabs(market.line) <= maxLine)) return false; // Also rejects nan/inf
+            return isQuarterMultiple(market.line);
+        }
+        return false;
+    }
+
+private:
+    // P(X <= k) over an integer support starting at 'offset'
+    struct Cumulative {
+        std::vector<double> cdf;
+        int offset = 0;
+
+        Cumulative() = default;
+        Cumulative(const std::vector<double>& pmf, int firstValue) : cdf(pmf.size()), offset(firstValue) {
+            double running = 0.0;
+            for (size_t i = 0; i < pmf.size(); ++i) {
+                running += pmf[i];
+                cdf[i] = running;
+            }
+        }
+
+        double atMost(int value) const {
+            int index = value - offset;
+            if (index < 0 || cdf.empty()) return 0.0;
+            if (index >= static_cast<int>(cdf.size())) return 1.0;
+            return cdf[index];
+        }
+        double exactly(int value) const { return atMost(value) - atMost(value - 1); }
+        // Values at or past +/-reach() are outside the support, so clamping a
+        // line to it doesn't change how it settles
+        double reach() const { return static_cast<double>(cdf.size()) + std::abs(offset) + 1.0; }
+    };
+
+    int maxGoals = 0, maxCorners = 0;
+    int startHomeGoals = 0, startAwayGoals = 0; // Score the grid is added to
+    std::vector<double> scoreGrid; // Row-major P(home scores h more, away scores a more)
+    double bttsYes = 0.0, homeWinToNil = 0.0, awayWinToNil = 0.0;
+    Cumulative totalGoals, homeGoals, awayGoals, goalDiff;
+    Cumulative totalCorners, cornerDiff;
+
+    static std::vector<double> poissonPmf(double lambda, int maxValue) {
+        std::vector<double> pmf(maxValue + 1, 0.0);
+        double p = std::exp(-lambda), sum = 0.0;
+        for (int k = 0; k <= maxValue; ++k) {
+            if (k > 0) p *= lambda / k;
+            pmf[k] = p;
+            sum += p;
+        }
+        pmf[maxValue] += std::max(0.0, 1.0 - sum); // Tail mass into the last bucket
+        return pmf;
+    }
+
+    static bool isQuarterMultiple(double line) {
+        double quarters = line * 4.0;
+        return std::fabs(quarters - std::round(quarters)) < 1e-9;
+    }
+
+    static MarketQuote outright(double probability) {
+        return finish(MarketQuote{probability, 0.0, 1.0 - probability, 0.0});
+    }
+
+    static MarketQuote finish(MarketQuote quote) {
+        quote.fairOdds = quote.win > 0.0 ? (1.0 - quote.push) / quote.win : 0.0;
+        return quote;
+    }
+
+    // Settles "X + line > 0" (win), "== 0" (push), "< 0" (lose) for a whole or
+    // half line on an integer variable
+    static MarketQuote settleSingle(const Cumulative& dist, double line) {
+        double threshold = -line; // Win when X > threshold
+        MarketQuote quote;
+        if (threshold == std::floor(threshold)) {
+            int t = static_cast<int>(threshold);
+            quote.push = dist.exactly(t);
+            quote.lose = dist.atMost(t - 1);
+        } else {
+            quote.lose = dist.atMost(static_cast<int>(std::floor(threshold)));
+        }
+        quote.win = 1.0 - quote.push - quote.lose;
+        return quote;
+    }
+
+    // Quarter lines are half stake on line-0.25 and half on line+0.25
+    static MarketQuote settle(const Cumulative& dist, double line) {
+        line = std::max(-dist.reach(), std::min(dist.reach(), line)); // Keeps the int conversions defined
+        double quarters = std::round(line * 4.0);
+        if (static_cast<long long>(std::fabs(quarters)) % 2 == 0) return finish(settleSingle(dist, line));
+
+        MarketQuote lower = settleSingle(dist, line - 0.25);
+        MarketQuote upper = settleSingle(dist, line + 0.25);
+        return finish(MarketQuote{(lower.win + upper.win) / 2.0, (lower.push + upper.push) / 2.0,
+                                  (lower.lose + upper.lose) / 2.0, 0.0});
+    }
+
+    // Over L wins when X - L > 0; Under L wins when -X + L > 0, i.e. on the
+    // mirrored variable. Mirroring is done by swapping win and lose of "over".
+    static MarketQuote overUnder(const Cumulative& dist, MarketSide side, double line) {
+        MarketQuote over = settle(dist, -line);
+        if (side != MarketSide::Under) return over;
+        return finish(MarketQuote{over.lose, over.push, over.win, 0.0});
+    }
+
+    // Home -1.5 wins when (home - away) - 1.5 > 0; Away +1.5 wins when
+    // (away - home) + 1.5 > 0, which is the losing side of Home -1.5.
+    static MarketQuote handicap(const Cumulative& diff, MarketSide side, double line) {
+        if (side != MarketSide::Away) return settle(diff, line);
+        MarketQuote home = settle(diff, -line);
+        return finish(MarketQuote{home.lose, home.push, home.win, 0.0});
+    }
+};
+
+#endif // MARKETENGINE_H
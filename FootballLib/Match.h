@@ -8,25 +8,94 @@
 #include <string>
 #include <algorithm>
 #include <numeric>
+#include <array>
+#include <utility>
 #include "Team.h" // Needs Team definition
 
+// Market groups a simulation run can tally, combined as a bit set. Win/Draw/Loss
+// is always tallied. Each combination has its own compiled kernel.
+enum SimFeature : unsigned {
+    SimGoalTotals = 1 << 0, // Over 0.5 / 1.5 / 2.5
+    SimBtts       = 1 << 1,
+    SimCorners    = 1 << 2, // Corner sampling is skipped entirely without this
+    SimScores     = 1 << 3, // Correct score counts (getMostLikelyScores)
+    SimAll        = SimGoalTotals | SimBtts | SimCorners | SimScores
+};
+
+// Poisson rates for one fixture: goals and corners for each side
+struct MatchLambdas {
+    double homeGoals = 0.0;
+    double awayGoals = 0.0;
+    double homeCorners = 0.0;
+    double awayCorners = 0.0;
+};
+
 class Match {
 public:
+    // Expected goals/corners from team strengths and league averages
+    static MatchLambdas expectedRates(const Team& home, const Team& away,
+                                      double avgHomeGoals, double avgAwayGoals,
+                                      double avgHomeCorners, double avgAwayCorners)
+    {
+        MatchLambdas rates;
+        rates.homeGoals = home.homeAttackStrength * away.awayDefenseStrength * avgHomeGoals;
+        rates.awayGoals = away.awayAttackStrength * home.homeDefenseStrength * avgAwayGoals;
+        if (rates.homeGoals < 0.01) rates.homeGoals = 0.01;
+        if (rates.awayGoals < 0.01) rates.awayGoals = 0.01;
+
+        rates.homeCorners = home.homeCornerAttackStrength * away.awayCornerDefenseStrength * avgHomeCorners;
+        rates.awayCorners = away.awayCornerAttackStrength * home.homeCornerDefenseStrength * avgAwayCorners;
+        if (rates.homeCorners < 0.01) rates.homeCorners = 0.01;
+        if (rates.awayCorners < 0.01) rates.awayCorners = 0.01;
+        return rates;
+    }
+
+    // Every market the simulation tallies
     void runFullSimulation(const Team& home, const Team& away,
                            double avgHomeGoals, double avgAwayGoals,
                            double avgHomeCorners, double avgAwayCorners)
+    {
+        runKernel<SimAll>(home, away, avgHomeGoals, avgAwayGoals, avgHomeCorners, avgAwayCorners);
+    }
+
+    // Only the requested SimFeature bits; 1X2 is always tallied. Dispatches to
+    // a kernel compiled for exactly that set, so e.g. a goals-only run never
+    // samples corners. Getters for markets that weren't requested return 0
+    // (see wasSimulated).
+    void runSimulation(unsigned features, const Team& home, const Team& away,
+                       double avgHomeGoals, double avgAwayGoals,
+                       double avgHomeCorners, double avgAwayCorners)
+    {
+        static const auto kernels = makeKernels(std::make_index_sequence<SimAll + 1>{});
+        (this->*kernels[features & SimAll])(home, away, avgHomeGoals, avgAwayGoals, avgHomeCorners, avgAwayCorners);
+    }
+
+    template <unsigned Features>
+    void runKernel(const Team& home, const Team& away,
+                   double avgHomeGoals, double avgAwayGoals,
+                   double avgHomeCorners, double avgAwayCorners)
     {
         // Reset stats
+        simulatedFeatures = Features;
         homeWins = 0; draws = 0; awayWins = 0;
         over05 = 0; over15 = 0; over25 = 0;
         totalSimulatedCorners = 0;
         cornerCounts.clear();
+        cornersAtMost.clear();
         scoreCounts.clear();
         bttsCount = 0; // NEW: Reset BTTS counter
 
+        // Rates and distributions only depend on the fixture, so build them once per run
+        MatchLambdas rates = expectedRates(home, away, avgHomeGoals, avgAwayGoals, avgHomeCorners, avgAwayCorners);
+        std::poisson_distribution<> distHomeG(rates.homeGoals);
+        std::poisson_distribution<> distAwayG(rates.awayGoals);
+        std::poisson_distribution<> distHomeC(rates.homeCorners);
+        std::poisson_distribution<> distAwayC(rates.awayCorners);
+        std::mt19937& gen = generator();
 
         for (int i = 0; i < simulationsToRun; ++i) {
-            simulateSingleGame(home, away, avgHomeGoals, avgAwayGoals, avgHomeCorners, avgAwayCorners);
+            int homeGoals = distHomeG(gen);
+            int awayGoals = distAwayG(gen);
 
             // Tally Win/Draw/Loss
             if (homeGoals > awayGoals) homeWins++;
@@ -34,25 +103,47 @@ public:
             else draws++;
 
             // Tally Goal Over/Under
-            int totalGoals = homeGoals + awayGoals;
-            if (totalGoals > 0) over05++;
-            if (totalGoals > 1) over15++;
-            if (totalGoals > 2) over25++;
+            if constexpr ((Features & SimGoalTotals) != 0) {
+                int totalGoals = homeGoals + awayGoals;
+                if (totalGoals > 0) over05++;
+                if (totalGoals > 1) over15++;
+                if (totalGoals > 2) over25++;
+            }
 
             // NEW: Tally BTTS
-            if (homeGoals > 0 && awayGoals > 0) {
-                bttsCount++;
+            if constexpr ((Features & SimBtts) != 0) {
+                if (homeGoals > 0 && awayGoals > 0) {
+                    bttsCount++;
+                }
             }
 
             // Tally Corner stats
-            int totalCorners = homeCorners + awayCorners;
-            totalSimulatedCorners += totalCorners;
-            cornerCounts[totalCorners]++;
+            if constexpr ((Features & SimCorners) != 0) {
+                int totalCorners = distHomeC(gen) + distAwayC(gen);
+                totalSimulatedCorners += totalCorners;
+                if (totalCorners >= static_cast<int>(cornerCounts.size())) cornerCounts.resize(totalCorners + 1, 0);
+                cornerCounts[totalCorners]++;
+            }
 
-            scoreCounts[{homeGoals, awayGoals}]++;
+            if constexpr ((Features & SimScores) != 0) {
+                scoreCounts[{homeGoals, awayGoals}]++;
+            }
+        }
+
+        // Running totals so any corner line is answered without rescanning
+        if constexpr ((Features & SimCorners) != 0) {
+            cornersAtMost.assign(cornerCounts.size(), 0);
+            int runningCount = 0;
+            for (size_t total = 0; total < cornerCounts.size(); ++total) {
+                runningCount += cornerCounts[total];
+                cornersAtMost[total] = runningCount;
+            }
         }
     }
 
+    // True if the last run tallied this SimFeature group
+    bool wasSimulated(SimFeature feature) const { return (simulatedFeatures & feature) != 0; }
+
     // --- Goal Getters ---
     double getHomeWinPercent() const { return (simulationsToRun > 0) ? (double)homeWins / simulationsToRun * 100.0 : 0.0;}
     double getDrawPercent() const { return (simulationsToRun > 0) ? (double)draws / simulationsToRun * 100.0 : 0.0;}
@@ -63,17 +154,17 @@ public:
 
     // --- NEW: BTTS Getters ---
     double getBttsYesPercent() const { return (simulationsToRun > 0) ? (double)bttsCount / simulationsToRun * 100.0 : 0.0; }
-    double getBttsNoPercent() const { return 100.0 - getBttsYesPercent(); }
+    double getBttsNoPercent() const { return wasSimulated(SimBtts) ? 100.0 - getBttsYesPercent() : 0.0; }
 
 
     // --- Corner Getters ---
     double getAverageTotalCorners() const { return (simulationsToRun > 0) ? static_cast<double>(totalSimulatedCorners) / simulationsToRun : 0.0; }
     double getCornerPercent(double line, bool over) const {
-        int count = 0;
-        for(const auto& pair : cornerCounts) {
-            if (over && pair.first > line) { count += pair.second; }
-            else if (!over && pair.first < line) { count += pair.second; }
-        }
+        if (!wasSimulated(SimCorners)) return 0.0;
+        // Over: totals > line = all minus totals <= floor(line)
+        // Under: totals < line = totals <= ceil(line) - 1
+        int count = over ? simulationsToRun - cornersAtMostCount(static_cast<int>(std::floor(line)))
+                         : cornersAtMostCount(static_cast<int>(std::ceil(line)) - 1);
         return (simulationsToRun > 0) ? static_cast<double>(count) / simulationsToRun * 100.0 : 0.0;
     }
 
@@ -94,46 +185,38 @@ public:
 
 private:
     // Goal related
-    int homeGoals = 0, awayGoals = 0;
     int homeWins = 0, draws = 0, awayWins = 0;
     int over05 = 0, over15 = 0, over25 = 0;
     std::map<std::pair<int, int>, int> scoreCounts;
     int bttsCount = 0; // NEW: BTTS counter
 
     // Corner related
-    int homeCorners = 0, awayCorners = 0;
     long long totalSimulatedCorners = 0;
-    std::map<int, int> cornerCounts;
+    std::vector<int> cornerCounts;  // Indexed by total corners
+    std::vector<int> cornersAtMost; // Simulations with total corners <= index
+
+    int cornersAtMostCount(int total) const {
+        if (total < 0 || cornersAtMost.empty()) return 0;
+        if (total >= static_cast<int>(cornersAtMost.size())) return cornersAtMost.back();
+        return cornersAtMost[total];
+    }
 
     int simulationsToRun = 10000;
+    unsigned simulatedFeatures = 0; // SimFeature bits of the last run; 0 before any run
 
 
-    void simulateSingleGame(const Team& home, const Team& away,
-                            double avgHomeGoals, double avgAwayGoals,
-                            double avgHomeCorners, double avgAwayCorners)
-    {
-        double lambdaHomeG = home.homeAttackStrength * away.awayDefenseStrength * avgHomeGoals;
-        double lambdaAwayG = away.awayAttackStrength * home.homeDefenseStrength * avgAwayGoals;
-        if (lambdaHomeG < 0.01) lambdaHomeG = 0.01;
-        if (lambdaAwayG < 0.01) lambdaAwayG = 0.01;
-
-        double lambdaHomeC = home.homeCornerAttackStrength * away.awayCornerDefenseStrength * avgHomeCorners;
-        double lambdaAwayC = away.awayCornerAttackStrength * home.homeCornerDefenseStrength * avgAwayCorners;
-        if (lambdaHomeC < 0.01) lambdaHomeC = 0.01;
-        if (lambdaAwayC < 0.01) lambdaAwayC = 0.01;
-
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-
-        std::poisson_distribution<> distHomeG(lambdaHomeG);
-        std::poisson_distribution<> distAwayG(lambdaAwayG);
-        std::poisson_distribution<> distHomeC(lambdaHomeC);
-        std::poisson_distribution<> distAwayC(lambdaAwayC);
-
-        homeGoals = distHomeG(gen);
-        awayGoals = distAwayG(gen);
-        homeCorners = distHomeC(gen);
-        awayCorners = distAwayC(gen);
+    using KernelFn = void (Match::*)(const Team&, const Team&, double, double, double, double);
+
+    template <size_t... FeatureSets>
+    static constexpr std::array<KernelFn, sizeof...(FeatureSets)> makeKernels(std::index_sequence<FeatureSets...>) {
+        return {{ &Match::runKernel<static_cast<unsigned>(FeatureSets)>... }};
+    }
+
+    // One generator per thread so concurrent Match instances don't race
+    static std::mt19937& generator() {
+        thread_local std::random_device rd;
+        thread_local std::mt19937 gen(rd());
+        return gen;
     }
 };
 
@@ -0,0 +1,900 @@
+#ifndef PREDICTIONSERVER_H
+#define PREDICTIONSERVER_H
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <set>
+#include <list>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "DataTypes.h"
+#include "Team.h"
+#include "DataLoader.h"
+#include "Match.h"
+#include "MarketEngine.h"
+#include "InPlay.h"
+
+// Long-running query server. Data is loaded once by the caller; queries arrive
+// as comma-separated lines (same style as the CSV inputs) and are answered by
+// a pool of worker threads:
+//
+//   PREDICT,<dd/mm/yyyy>,<HomeTeam>,<AwayTeam>[,FORM|RATING[,<groups>]]
+//                               groups joined by '+' from 1X2, GOALS, BTTS, CORNERS,
+//                               SCORES, ALL (default ALL); only those are simulated
+//   FORM,<dd/mm/yyyy>,<Team>
+//   RATING,<dd/mm/yyyy>,<Team>  Elo splits and rating strengths before that date
+//   H2H,<HomeTeam>,<AwayTeam>[,<beforeDate>[,<maxMatches>]]
+//   MARKETS,<dd/mm/yyyy>,<HomeTeam>,<AwayTeam>,<spec>[,<spec>...]
+//                               specs as in MarketEngine::parseMarket, e.g. AH_HOME:-0.75
+//   INPLAY,<dd/mm/yyyy>,<HomeTeam>,<AwayTeam>,<minute>,<homeGoals>-<awayGoals>
+//          [,<homeReds>-<awayReds>[,<homeCorners>-<awayCorners>]][,<spec>...]
+//                               live re-price; without specs returns 1X2, totals and top scores.
+//                               Corner specs need the corners-so-far pair (reds first, 0-0 if none)
+//   RESULT,<dd/mm/yyyy>,<HomeTeam>,<AwayTeam>,<homeGoals>-<awayGoals>,<homeCorners>-<awayCorners>
+//                               add one completed match to the model in memory (see
+//                               DataLoader::appendResult); not written to the result files
+//   RELOAD                      re-read the result files and swap in the new model
+//
+// RESULT and RELOAD run in arrival order on one updater thread, so other
+// requests keep being answered while they run.
+//
+// Any command that names teams also takes an optional DIV=<code> field (anywhere
+// after the command) to pick the division. Without it, a team in several
+// divisions resolves to the one with its most recent result.
+//
+// Each reply is one line: <seq>,<OK|ERR>,<latencyUs>,<key=value;key=value...>
+// where <seq> is the 1-based line number of the request on its connection.
+// Replies may come back out of order when several workers are busy. Each batch
+// works on one model snapshot, so a RELOAD never shows it half-updated data.
+class PredictionServer {
+public:
+    PredictionServer(DataLoader& dataLoader, unsigned workerCount = 0, size_t maxBatchSize = 64)
+        : loader(dataLoader), batchLimit(maxBatchSize == 0 ? 1 : maxBatchSize)
+    {
+        // Self-pipe for requestStop(); non-blocking so a signal handler never waits on it
+        if (::pipe(wakePipe) == 0) {
+            for (int fd : wakePipe) ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+        } else {
+            wakePipe[0] = wakePipe[1] = -1;
+        }
+        updater = std::thread(&PredictionServer::updaterLoop, this);
+        if (workerCount == 0) workerCount = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < workerCount; ++i) {
+            workers.emplace_back(&PredictionServer::workerLoop, this);
+        }
+    }
+
+    ~PredictionServer() {
+        stop();
+        for (int fd : wakePipe) if (fd >= 0) ::close(fd);
+    }
+
+    PredictionServer(const PredictionServer&) = delete;
+    PredictionServer& operator=(const PredictionServer&) = delete;
+
+    // --- Line protocol over stdin/stdout. Returns once stdin hits EOF or
+    // requestStop() is called, and every queued request has been answered.
+    // Pass a separate reply stream when std::cout is redirected away from the
+    // real stdout. Reads the stdin fd directly, so don't mix with std::cin. ---
+    void serveStdio(std::ostream& replies = std::cout) {
+        auto sink = std::make_shared<ResponseSink>(&replies);
+        readRequests(STDIN_FILENO, sink, true);
+        stop();
+        sink->finish();
+    }
+
+    // --- Line protocol over a Unix domain socket. Each client connection gets
+    // a reader thread; requests from all clients share the worker pool.
+    // Blocks until requestStop() (e.g. from a SIGINT/SIGTERM handler) or
+    // stop() is called, then answers what is queued and removes the socket. ---
+    bool serveUnixSocket(const std::string& socketPath) {
+        sockaddr_un addr{};
+        if (socketPath.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "Error: Socket path too long: " << socketPath << std::endl;
+            return false;
+        }
+
+        listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0) {
+            std::cerr << "Error: Could not create socket: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+        ::unlink(socketPath.c_str()); // Remove a stale socket from a previous run
+
+        if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+            ::listen(listenFd, SOMAXCONN) < 0) {
+            std::cerr << "Error: Could not listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+            ::close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+
+        std::cerr << "Listening on " << socketPath << " with " << workers.size() << " worker(s)" << std::endl;
+
+        while (!stopping) {
+            if (!waitReadable(listenFd)) break; // requestStop()
+            int clientFd = ::accept(listenFd, nullptr, nullptr);
+            if (clientFd < 0) {
+                if (errno == EINTR) continue;
+                break; // Listening socket was shut down by stop()
+            }
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            if (stopping) { ::close(clientFd); break; }
+
+            // Join readers whose clients have already disconnected
+            for (auto it = clientThreads.begin(); it != clientThreads.end();) {
+                if (*it->finished) { it->thread.join(); it = clientThreads.erase(it); }
+                else ++it;
+            }
+
+            auto finished = std::make_shared<std::atomic<bool>>(false);
+            clientThreads.push_back(ClientReader{std::thread(&PredictionServer::clientLoop, this, clientFd, finished), finished});
+        }
+
+        stop();
+        ::close(listenFd.exchange(-1));
+        ::unlink(socketPath.c_str());
+        return true;
+    }
+
+    // Asks serveStdio / serveUnixSocket to stop and drain. Only writes one
+    // byte to a pipe, so it is safe to call from a signal handler.
+    void requestStop() {
+        char byte = 1;
+        if (wakePipe[1] >= 0 && ::write(wakePipe[1], &byte, 1) < 0) { /* Pipe full: a wake-up is already pending */ }
+    }
+
+    // Stops accepting input, answers everything already queued, then joins
+    void stop() {
+        if (stopping.exchange(true)) return;
+
+        requestStop(); // Wake a serve loop blocked in poll()
+        int listening = listenFd;
+        if (listening >= 0) ::shutdown(listening, SHUT_RDWR);
+
+        // Unblock client readers first so nothing is enqueued after workers exit
+        std::list<ClientReader> readers;
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            for (ResponseSink* sink : openClients) sink->stopInput();
+            readers.swap(clientThreads);
+        }
+        for (auto& reader : readers) {
+            if (reader.thread.joinable()) reader.thread.join();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            workersDraining = true;
+        }
+        queueReady.notify_all();
+        for (auto& worker : workers) {
+            if (worker.joinable()) worker.join();
+        }
+
+        // Workers may have handed over a RELOAD or RESULT just before exiting; answer it too
+        {
+            std::lock_guard<std::mutex> lock(updateMutex);
+            updaterDraining = true;
+        }
+        updateReady.notify_all();
+        if (updater.joinable()) updater.join();
+    }
+
+private:
+    static constexpr size_t maxInFlightPerClient = 1024; // Reader stops reading past this
+    static constexpr int clientSendTimeoutSec = 5;       // A client not reading this long is dropped
+
+    // One connection's outbound side (stdout or a client socket). Workers only
+    // append to its queue; the connection's own writer thread does the blocking
+    // writes, so a client that stops reading stalls nobody but itself.
+    struct ResponseSink {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<std::string> outbound;
+        size_t inFlight = 0;       // Requests admitted whose reply isn't written yet
+        bool inputDone = false;    // Reader finished; writer exits once inFlight is 0
+        bool inputStopped = false; // stop(): admit nothing more
+        bool dropped = false;      // Write failed or timed out; replies are discarded
+        std::ostream* out = nullptr;
+        int fd = -1;
+        std::thread writer;
+
+        explicit ResponseSink(std::ostream* stream) : out(stream) { writer = std::thread(&ResponseSink::writerLoop, this); }
+        explicit ResponseSink(int socketFd) : fd(socketFd) {
+            timeval timeout{clientSendTimeoutSec, 0};
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            writer = std::thread(&ResponseSink::writerLoop, this);
+        }
+        ~ResponseSink() {
+            finish();
+            if (fd >= 0) ::close(fd);
+        }
+
+        // Reader side: wait for a free in-flight slot. False once the client
+        // was dropped or the server is stopping.
+        bool admit() {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return dropped || inputStopped || inFlight < maxInFlightPerClient; });
+            if (dropped || inputStopped) return false;
+            ++inFlight;
+            return true;
+        }
+
+        // Worker side: never blocks on the client
+        void write(std::string line) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (dropped) {
+                --inFlight;
+            } else {
+                outbound.push_back(std::move(line));
+            }
+            changed.notify_all();
+        }
+
+        void stopInput() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                inputStopped = true;
+            }
+            changed.notify_all();
+            if (fd >= 0) ::shutdown(fd, SHUT_RD); // End a reader blocked in read()
+        }
+
+        // No more requests will be admitted; wait until every reply is written
+        // (or the client is dropped), then stop the writer
+        void finish() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                inputDone = true;
+            }
+            changed.notify_all();
+            if (writer.joinable()) writer.join();
+        }
+
+        void writerLoop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                changed.wait(lock, [this] { return !outbound.empty() || (inputDone && inFlight == 0) || dropped; });
+                if (outbound.empty()) return; // Everything answered, or dropped
+                std::string line = std::move(outbound.front());
+                outbound.pop_front();
+
+                lock.unlock();
+                bool sent = send(line + '\n');
+                lock.lock();
+
+                --inFlight;
+                if (!sent) {
+                    // Too far behind (send timed out) or gone: discard what's queued
+                    dropped = true;
+                    inFlight -= outbound.size();
+                    outbound.clear();
+                    if (fd >= 0) ::shutdown(fd, SHUT_RDWR);
+                }
+                changed.notify_all();
+                if (dropped) return;
+            }
+        }
+
+        bool send(const std::string& data) {
+            if (out) {
+                *out << data << std::flush;
+                return static_cast<bool>(*out);
+            }
+            size_t sent = 0;
+            while (sent < data.size()) {
+                ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) std::cerr << "Dropping client: not reading replies" << std::endl;
+                    return false;
+                }
+                sent += static_cast<size_t>(n);
+            }
+            return true;
+        }
+    };
+
+    struct ClientReader {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> finished;
+    };
+
+    using FormCache = std::map<std::tuple<std::string, std::string, std::string>, Team>; // (division, date, team) -> form
+
+    struct Request {
+        std::string line;
+        long seq;
+        std::chrono::steady_clock::time_point received;
+        std::shared_ptr<ResponseSink> sink;
+    };
+
+    DataLoader& loader;
+    size_t batchLimit;
+
+    std::deque<Request> queue;
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    bool workersDraining = false;
+    std::atomic<bool> stopping{false};
+
+    std::vector<std::thread> workers;
+
+    std::thread updater;                  // Runs RELOAD and RESULT off the worker pool
+    std::vector<Request> pendingUpdates;
+    std::mutex updateMutex;
+    std::condition_variable updateReady;
+    bool updaterDraining = false;
+    std::list<ClientReader> clientThreads;
+    std::set<ResponseSink*> openClients;
+    std::mutex clientsMutex;
+    std::atomic<int> listenFd{-1};
+    int wakePipe[2] = {-1, -1}; // Read end polled by the serve loops; requestStop() writes
+
+    void enqueue(Request request) {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            queue.push_back(std::move(request));
+        }
+        queueReady.notify_one();
+    }
+
+    void clientLoop(int clientFd, std::shared_ptr<std::atomic<bool>> finished) {
+        // The sink owns the fd and closes it once the last pending reply is written
+        auto sink = std::make_shared<ResponseSink>(clientFd);
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            openClients.insert(sink.get());
+            if (stopping) sink->stopInput(); // Raced with stop(); don't block in recv
+        }
+        // stop() ends this read via stopInput(), so no need to watch the wake pipe
+        readRequests(clientFd, sink, false);
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            openClients.erase(sink.get());
+        }
+        sink->finish(); // Replies still queued are written by the sink's own thread
+        *finished = true;
+    }
+
+    // True once 'fd' is readable; false if requestStop() woke us instead
+    bool waitReadable(int fd) {
+        pollfd fds[2] = {{fd, POLLIN, 0}, {wakePipe[0], POLLIN, 0}};
+        while (true) {
+            int ready = ::poll(fds, wakePipe[0] >= 0 ? 2 : 1, -1);
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready < 0) return true; // Let the caller's read/accept report the error
+            if (fds[1].revents & POLLIN) return false;
+            return true;
+        }
+    }
+
+    // Splits the byte stream from 'fd' into request lines until EOF (or a
+    // requestStop() when 'watchWake' is set). A final line without '\n' counts.
+    void readRequests(int fd, const std::shared_ptr<ResponseSink>& sink, bool watchWake) {
+        std::string pending;
+        char buffer[4096];
+        long seq = 0;
+
+        auto submit = [&](std::string line) {
+            ++seq;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) return true;
+            if (!sink->admit()) return false; // Blocks while this client has too many requests in flight
+            enqueue(Request{std::move(line), seq, std::chrono::steady_clock::now(), sink});
+            return true;
+        };
+
+        while (true) {
+            if (watchWake && !waitReadable(fd)) return;
+            ssize_t n = ::read(fd, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            pending.append(buffer, static_cast<size_t>(n));
+
+            size_t start = 0, newline;
+            while ((newline = pending.find('\n', start)) != std::string::npos) {
+                if (!submit(pending.substr(start, newline - start))) return;
+                start = newline + 1;
+            }
+            pending.erase(0, start);
+        }
+        if (!pending.empty()) submit(pending);
+    }
+
+    void workerLoop() {
+        Match match; // Per-worker simulator; Match keeps per-run tallies
+
+        while (true) {
+            std::vector<Request> batch;
+            bool moreQueued = false;
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueReady.wait(lock, [this] { return workersDraining || !queue.empty(); });
+                if (queue.empty()) return; // Draining and nothing left
+
+                // Take everything that arrived together, up to the batch limit
+                while (!queue.empty() && batch.size() < batchLimit) {
+                    batch.push_back(std::move(queue.front()));
+                    queue.pop_front();
+                }
+                moreQueued = !queue.empty();
+            }
+            if (moreQueued) queueReady.notify_one(); // Let another worker pick up the rest
+
+            processBatch(batch, match);
+            // About to go idle: don't keep a snapshot pinned that a reload may retire
+            if (!moreQueued) DataLoader::releaseCachedSnapshot();
+        }
+    }
+
+    // Requests in one batch share form results, so a team that appears in
+    // several queries for the same date has its history scanned once.
+    void processBatch(std::vector<Request>& batch, Match& match) {
+        std::shared_ptr<const ModelSnapshot> model = loader.snapshot();
+        FormCache formCache;
+
+        for (Request& request : batch) {
+            if (isModelUpdate(request.line)) {
+                // A reload can take seconds and holds the loader's writer lock;
+                // the rest of the batch shouldn't wait for it
+                {
+                    std::lock_guard<std::mutex> lock(updateMutex);
+                    pendingUpdates.push_back(std::move(request));
+                }
+                updateReady.notify_one();
+                continue;
+            }
+
+            bool ok = false;
+            std::string payload;
+            // One bad request must not take down the worker and every queued reply
+            try {
+                ok = dispatch(request.line, *model, formCache, match, payload);
+            } catch (...) {
+                ok = false;
+                payload = "error=internal";
+            }
+
+            reply(request, ok, payload);
+        }
+    }
+
+    static void reply(Request& request, bool ok, const std::string& payload) {
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - request.received).count();
+
+        std::ostringstream line;
+        line << request.seq << ',' << (ok ? "OK" : "ERR") << ',' << latency << ',' << payload;
+        request.sink->write(line.str());
+    }
+
+    static bool isModelUpdate(const std::string& line) {
+        std::string command = commandOf(line);
+        return command == "RELOAD" || command == "RESULT";
+    }
+
+    static std::string commandOf(const std::string& line) {
+        std::string command = line.substr(0, line.find(','));
+        std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+        return command;
+    }
+
+    // Updates are applied in arrival order. Back-to-back RELOADs queued while
+    // a reload runs are coalesced into one and all get its result. Predictions
+    // carry on with the old snapshot meanwhile.
+    void updaterLoop() {
+        while (true) {
+            std::vector<Request> updates;
+            {
+                std::unique_lock<std::mutex> lock(updateMutex);
+                updateReady.wait(lock, [this] { return updaterDraining || !pendingUpdates.empty(); });
+                if (pendingUpdates.empty()) return; // Draining and nothing left
+                updates.swap(pendingUpdates);
+            }
+
+            for (size_t first = 0; first < updates.size();) {
+                bool reload = commandOf(updates[first].line) == "RELOAD";
+                size_t last = first + 1;
+                while (reload && last < updates.size() && commandOf(updates[last].line) == "RELOAD") ++last;
+
+                bool ok = false;
+                std::string payload;
+                try {
+                    ok = reload ? handleReload(payload) : handleResult(updates[first].line, payload);
+                } catch (...) {
+                    ok = false;
+                    payload = "error=internal";
+                }
+                for (size_t i = first; i < last; ++i) reply(updates[i], ok, payload);
+                first = last;
+            }
+            DataLoader::releaseCachedSnapshot();
+        }
+    }
+
+    bool handleReload(std::string& payload) {
+        if (!loader.reload()) { payload = "error=reload failed"; return false; }
+        std::shared_ptr<const ModelSnapshot> reloaded = loader.snapshot();
+        size_t teamCount = 0;
+        for (const auto& pair : reloaded->leagues) teamCount += pair.second->loadedTeams.size();
+        payload = "leagues=" + std::to_string(reloaded->leagues.size()) + ";teams=" + std::to_string(teamCount);
+        return true;
+    }
+
+    // RESULT,<date>,<home>,<away>,<hg>-<ag>,<hc>-<ac>[,DIV=<code>]
+    bool handleResult(const std::string& line, std::string& payload) {
+        std::vector<std::string> fields = splitFields(line);
+        std::string division = takeDivision(fields);
+        if (fields.size() < 6) { payload = "error=unknown command or missing arguments"; return false; }
+
+        MatchResult result{fields[1], {}, fields[2], fields[3], 0, 0};
+        int homeCorners = 0, awayCorners = 0;
+        if (!parsePair(fields[4], result.homeGoals, result.awayGoals)) { payload = "error=bad score " + fields[4]; return false; }
+        if (!parsePair(fields[5], homeCorners, awayCorners)) { payload = "error=bad corners " + fields[5]; return false; }
+
+        std::shared_ptr<const ModelSnapshot> model = loader.snapshot();
+        const LeagueModel* league = leagueOf(*model, division, fields[2], fields[3], payload);
+        if (!league) return false;
+        if (!loader.appendResult(league->division, result, homeCorners, awayCorners)) {
+            payload = "error=result rejected"; // Bad date, same team twice or older than the latest result
+            return false;
+        }
+        std::string code = league->division;
+        model = loader.snapshot(); // The one just published
+        const LeagueModel* updated = model->findLeague(code);
+        payload = "division=" + code + ";matches=" + std::to_string(updated ? updated->matchCount : 0);
+        return true;
+    }
+
+    // Runs one request line against the batch's snapshot; false means an ERR reply
+    bool dispatch(const std::string& line, const ModelSnapshot& model, FormCache& formCache,
+                  Match& match, std::string& payload) {
+        std::vector<std::string> fields = splitFields(line);
+        std::string command = fields.empty() ? "" : fields[0];
+        std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+        std::string division = takeDivision(fields);
+
+        bool ok = false;
+        if (command == "PREDICT" && fields.size() >= 4) {
+            const LeagueModel* league = leagueOf(model, division, fields[2], fields[3], payload);
+            ok = league && handlePredict(*league, fields, formCache, match, payload);
+        } else if (command == "MARKETS" && fields.size() >= 5) {
+            const LeagueModel* league = leagueOf(model, division, fields[2], fields[3], payload);
+            ok = league && handleMarkets(*league, fields, formCache, payload);
+        } else if (command == "INPLAY" && fields.size() >= 6) {
+            const LeagueModel* league = leagueOf(model, division, fields[2], fields[3], payload);
+            ok = league && handleInPlay(*league, fields, formCache, payload);
+        } else if (command == "RATING" && fields.size() >= 3) {
+            const LeagueModel* league = leagueOf(model, division, fields[2], "", payload);
+            ok = league && handleRating(*league, fields, payload);
+        } else if (command == "FORM" && fields.size() >= 3) {
+            const LeagueModel* league = leagueOf(model, division, fields[2], "", payload);
+            ok = league && handleForm(*league, fields, formCache, payload);
+        } else if (command == "H2H" && fields.size() >= 3) {
+            const LeagueModel* league = leagueOf(model, division, fields[1], fields[2], payload);
+            ok = league && handleH2H(*league, fields, payload);
+        } else {
+            payload = "error=unknown command or missing arguments";
+        }
+        return ok;
+    }
+
+    // League the request's team(s) play in; both teams must share one. An
+    // explicit division wins; otherwise see ModelSnapshot::leagueOfTeam.
+    const LeagueModel* leagueOf(const ModelSnapshot& model, const std::string& division, const std::string& teamName,
+                                const std::string& otherTeam, std::string& payload) const {
+        if (!division.empty()) {
+            const LeagueModel* league = model.findLeague(division);
+            if (!league) { payload = "error=unknown division"; return nullptr; }
+            if (!league->findTeam(teamName) || (!otherTeam.empty() && !league->findTeam(otherTeam))) {
+                payload = "error=unknown team";
+                return nullptr;
+            }
+            return league;
+        }
+
+        bool ambiguous = false;
+        const LeagueModel* league = model.leagueOfTeam(teamName, otherTeam, &ambiguous);
+        if (!league) payload = ambiguous ? "error=ambiguous division, add DIV=<code>" : "error=unknown team";
+        return league;
+    }
+
+    // Removes an optional DIV=<code> field and returns the code ("" if absent)
+    static std::string takeDivision(std::vector<std::string>& fields) {
+        for (size_t i = 1; i < fields.size(); ++i) {
+            if (fields[i].size() > 4 && ::toupper(fields[i][0]) == 'D' && ::toupper(fields[i][1]) == 'I' &&
+                ::toupper(fields[i][2]) == 'V' && fields[i][3] == '=') {
+                std::string division = fields[i].substr(4);
+                fields.erase(fields.begin() + i);
+                return division;
+            }
+        }
+        return "";
+    }
+
+    // Form for one team at one date, computed at most once per batch
+    const Team* formFor(const LeagueModel& model, const std::string& dateStr, const std::string& teamName,
+                        FormCache& formCache, std::string& payload) {
+        if (!model.findTeam(teamName)) { payload = "error=unknown team"; return nullptr; }
+
+        auto key = std::make_tuple(model.division, dateStr, teamName);
+        auto it = formCache.find(key);
+        if (it == formCache.end()) {
+            Team form;
+            if (!loader.calculateTeamForm(model, teamName, dateStr, form)) { payload = "error=invalid date"; return nullptr; }
+            it = formCache.emplace(std::move(key), std::move(form)).first;
+        }
+        return &it->second;
+    }
+
+    bool handlePredict(const LeagueModel& model, const std::vector<std::string>& fields,
+                       FormCache& formCache, Match& match, std::string& payload) {
+        std::string source = fields.size() >= 5 ? fields[4] : "FORM";
+        std::transform(source.begin(), source.end(), source.begin(), ::toupper);
+
+        Team homeRating, awayRating;
+        const Team* home = nullptr;
+        const Team* away = nullptr;
+        if (source == "RATING") {
+            if (!model.findTeam(fields[2]) || !model.findTeam(fields[3])) { payload = "error=unknown team"; return false; }
+            if (!loader.calculateRatingStrengths(model, fields[2], fields[1], homeRating) ||
+                !loader.calculateRatingStrengths(model, fields[3], fields[1], awayRating)) {
+                payload = "error=invalid date";
+                return false;
+            }
+            home = &homeRating;
+            away = &awayRating;
+        } else if (source == "FORM") {
+            home = formFor(model, fields[1], fields[2], formCache, payload);
+            away = home ? formFor(model, fields[1], fields[3], formCache, payload) : nullptr;
+            if (!home || !away) return false;
+        } else {
+            payload = "error=unknown strength source " + fields[4];
+            return false;
+        }
+
+        unsigned features = SimAll;
+        if (fields.size() >= 6 && !parseSimFeatures(fields[5], features)) {
+            payload = "error=bad market groups " + fields[5];
+            return false;
+        }
+
+        // Kernel compiled for exactly these groups, e.g. 1X2 alone skips corners and score counts
+        match.runSimulation(features, *home, *away,
+                            model.leagueAvgHomeGoalsScored, model.leagueAvgAwayGoalsScored,
+                            model.leagueAvgHomeCorners, model.leagueAvgAwayCorners);
+
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2)
+            << "home=" << match.getHomeWinPercent()
+            << ";draw=" << match.getDrawPercent()
+            << ";away=" << match.getAwayWinPercent();
+        if (match.wasSimulated(SimGoalTotals)) {
+            out << ";over05=" << match.getOver05Percent()
+                << ";over15=" << match.getOver15Percent()
+                << ";over25=" << match.getOver25Percent();
+        }
+        if (match.wasSimulated(SimBtts)) out << ";btts=" << match.getBttsYesPercent();
+        if (match.wasSimulated(SimCorners)) out << ";avgCorners=" << match.getAverageTotalCorners();
+        for (const auto& score : match.getMostLikelyScores()) {
+            std::string label = score.first;
+            label.erase(std::remove(label.begin(), label.end(), ' '), label.end());
+            out << ";score_" << label << '=' << score.second;
+        }
+        payload = out.str();
+        return true;
+    }
+
+    // Prices each requested market as <spec>=<win>/<push>/<lose>@<fairOdds>
+    bool handleMarkets(const LeagueModel& model, const std::vector<std::string>& fields,
+                       FormCache& formCache, std::string& payload) {
+        std::vector<MarketRequest> markets(fields.size() - 4);
+        for (size_t i = 4; i < fields.size(); ++i) {
+            if (!MarketEngine::parseMarket(fields[i], markets[i - 4])) {
+                payload = "error=bad market " + fields[i];
+                return false;
+            }
+        }
+
+        const Team* home = formFor(model, fields[1], fields[2], formCache, payload);
+        const Team* away = home ? formFor(model, fields[1], fields[3], formCache, payload) : nullptr;
+        if (!home || !away) return false;
+
+        MarketEngine engine;
+        engine.build(*home, *away, model.leagueAvgHomeGoalsScored, model.leagueAvgAwayGoalsScored,
+                     model.leagueAvgHomeCorners, model.leagueAvgAwayCorners);
+        std::vector<MarketQuote> quotes = engine.price(markets);
+
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(4);
+        for (size_t i = 0; i < markets.size(); ++i) {
+            if (i > 0) out << ';';
+            out << markets[i].label << '=' << quotes[i].win << '/' << quotes[i].push << '/'
+                << quotes[i].lose << '@' << std::setprecision(3) << quotes[i].fairOdds << std::setprecision(4);
+        }
+        payload = out.str();
+        return true;
+    }
+
+    bool handleInPlay(const LeagueModel& model, const std::vector<std::string>& fields,
+                      FormCache& formCache, std::string& payload) {
+        InPlayState state;
+        size_t nextField = 6;
+        try {
+            state.minute = std::stoi(fields[4]);
+        } catch (...) { payload = "error=invalid minute"; return false; }
+        if (!parsePair(fields[5], state.homeGoals, state.awayGoals)) { payload = "error=invalid score"; return false; }
+        if (fields.size() > 6 && parsePair(fields[6], state.homeRedCards, state.awayRedCards)) nextField = 7;
+        bool cornersKnown = nextField == 7 && fields.size() > 7 && parsePair(fields[7], state.homeCorners, state.awayCorners);
+        if (cornersKnown) nextField = 8;
+
+        std::vector<MarketRequest> markets(fields.size() - nextField);
+        for (size_t i = nextField; i < fields.size(); ++i) {
+            if (!MarketEngine::parseMarket(fields[i], markets[i - nextField])) {
+                payload = "error=bad market " + fields[i];
+                return false;
+            }
+            // Remaining corners alone would misprice a corner line late in the match
+            MarketType type = markets[i - nextField].type;
+            if (!cornersKnown && (type == MarketType::TotalCorners || type == MarketType::CornerHandicap)) {
+                payload = "error=corners so far required for " + fields[i];
+                return false;
+            }
+        }
+
+        const Team* home = formFor(model, fields[1], fields[2], formCache, payload);
+        const Team* away = home ? formFor(model, fields[1], fields[3], formCache, payload) : nullptr;
+        if (!home || !away) return false;
+
+        MatchLambdas preMatch = Match::expectedRates(*home, *away,
+                                                     model.leagueAvgHomeGoalsScored, model.leagueAvgAwayGoalsScored,
+                                                     model.leagueAvgHomeCorners, model.leagueAvgAwayCorners);
+        MarketEngine engine;
+        InPlayPricer(model.inPlay).reprice(preMatch, state, engine);
+
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(4);
+        if (markets.empty()) {
+            static const char* defaultSpecs[] = {"1X2:H", "1X2:D", "1X2:A", "GOALS_OVER:0.5", "GOALS_OVER:1.5",
+                                                 "GOALS_OVER:2.5", "GOALS_OVER:3.5", "GOALS_OVER:4.5", "BTTS:YES"};
+            for (const char* spec : defaultSpecs) {
+                MarketRequest market;
+                MarketEngine::parseMarket(spec, market);
+                out << spec << '=' << engine.price(market).win << ';';
+            }
+            for (const auto& score : engine.getMostLikelyScores()) {
+                std::string label = score.first;
+                label.erase(std::remove(label.begin(), label.end(), ' '), label.end());
+                out << "score_" << label << '=' << score.second / 100.0 << ';';
+            }
+        } else {
+            for (size_t i = 0; i < markets.size(); ++i) {
+                MarketQuote quote = engine.price(markets[i]);
+                out << markets[i].label << '=' << quote.win << '/' << quote.push << '/' << quote.lose << ';';
+            }
+        }
+        payload = out.str();
+        payload.pop_back(); // Trailing ';'
+        return true;
+    }
+
+    bool handleRating(const LeagueModel& model, const std::vector<std::string>& fields, std::string& payload) {
+        if (!model.findTeam(fields[2])) { payload = "error=unknown team"; return false; }
+        Team strengths;
+        if (!loader.calculateRatingStrengths(model, fields[2], fields[1], strengths)) { payload = "error=invalid date"; return false; }
+
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(1);
+        const RatingPoint* point = loader.getRatingBefore(model, fields[2], fields[1]);
+        if (point) out << "elo=" << point->elo << ";homeElo=" << point->homeElo << ";awayElo=" << point->awayElo << ';';
+        out << std::setprecision(4)
+            << "homeAttack=" << strengths.homeAttackStrength
+            << ";homeDefense=" << strengths.homeDefenseStrength
+            << ";awayAttack=" << strengths.awayAttackStrength
+            << ";awayDefense=" << strengths.awayDefenseStrength;
+        payload = out.str();
+        return true;
+    }
+
+    bool handleForm(const LeagueModel& model, const std::vector<std::string>& fields,
+                    FormCache& formCache, std::string& payload) {
+        const Team* form = formFor(model, fields[1], fields[2], formCache, payload);
+        if (!form) return false;
+
+        const Team& team = *form;
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(4)
+            << "homeAttack=" << team.homeAttackStrength
+            << ";homeDefense=" << team.homeDefenseStrength
+            << ";awayAttack=" << team.awayAttackStrength
+            << ";awayDefense=" << team.awayDefenseStrength;
+        payload = out.str();
+        return true;
+    }
+
+    bool handleH2H(const LeagueModel& model, const std::vector<std::string>& fields, std::string& payload) {
+        std::string beforeDate = fields.size() >= 4 ? fields[3] : "";
+        int maxMatches = 10;
+        if (fields.size() >= 5) {
+            try { maxMatches = std::stoi(fields[4]); } catch (...) { payload = "error=invalid maxMatches"; return false; }
+        }
+
+        H2HStats h2h = loader.getHeadToHeadStats(model, fields[1], fields[2], beforeDate, maxMatches);
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2)
+            << "matches=" << h2h.totalMatches
+            << ";homeWins=" << h2h.homeTeamWins
+            << ";draws=" << h2h.draws
+            << ";awayWins=" << h2h.awayTeamWins
+            << ";avgHomeGoals=" << h2h.avgHomeGoals
+            << ";avgAwayGoals=" << h2h.avgAwayGoals
+            << ";btts=" << h2h.bttsPercentage
+            << ";over25=" << h2h.over25Percentage;
+        payload = out.str();
+        return true;
+    }
+
+    // "GOALS+BTTS" style list of SimFeature groups; 1X2 is always included
+    static bool parseSimFeatures(const std::string& text, unsigned& features) {
+        static const std::map<std::string, unsigned> groups = {
+            {"1X2", 0u}, {"GOALS", SimGoalTotals}, {"BTTS", SimBtts},
+            {"CORNERS", SimCorners}, {"SCORES", SimScores}, {"ALL", SimAll}};
+        features = 0;
+        std::stringstream ss(text);
+        std::string group;
+        while (std::getline(ss, group, '+')) {
+            std::transform(group.begin(), group.end(), group.begin(), ::toupper);
+            auto it = groups.find(group);
+            if (it == groups.end()) return false;
+            features |= it->second;
+        }
+        return !text.empty();
+    }
+
+    // "<a>-<b>" with both parts non-negative integers of at most 3 digits
+    // (scores, cards and corners), so std::stoi can't go out of range
+    static bool parsePair(const std::string& text, int& first, int& second) {
+        size_t dash = text.find('-');
+        if (dash == std::string::npos || dash == 0 || dash > 3 || dash + 1 >= text.size() || text.size() - dash - 1 > 3) return false;
+        if (!std::all_of(text.begin(), text.begin() + dash, ::isdigit) ||
+            !std::all_of(text.begin() + dash + 1, text.end(), ::isdigit)) return false;
+        first = std::stoi(text.substr(0, dash));
+        second = std::stoi(text.substr(dash + 1));
+        return true;
+    }
+
+    static std::vector<std::string> splitFields(const std::string& line) {
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        std::string cell;
+        while (std::getline(ss, cell, ',')) { fields.push_back(cell); }
+        return fields;
+    }
+};
+
+#endif // PREDICTIONSERVER_H
@@ -0,0 +1,124 @@
+#ifndef RATINGENGINE_H
+#define RATINGENGINE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include "DataTypes.h"
+#include "Team.h"
+
+// A team's ratings right after one of its matches
+struct RatingPoint {
+    std::chrono::system_clock::time_point date;
+    float elo;       // Overall Elo, every match
+    float homeElo;   // Elo from home matches only
+    float awayElo;   // Elo from away matches only
+
+    // Smoothed, opponent-adjusted goal strengths on the same scale as Team
+    // (1.0 = league average; defense is goals conceded, so lower is better)
+    float homeAttack, homeDefense;
+    float awayAttack, awayDefense;
+};
+
+// Single-pass rating ladder. Feeding results in date order updates both sides'
+// ratings in O(1) per match and appends a RatingPoint to each team's timeline,
+// so "ratings as of date D" is a binary search instead of a history rescan.
+class RatingEngine {
+public:
+    double eloK = 20.0;               // Elo update step
+    double eloHomeAdvantage = 60.0;   // Elo points added to the home side's expectation
+    double strengthSmoothing = 0.15;  // Weight of the newest match in goal strengths
+
+    // Rebuild from a date-sorted result table
+    void build(const std::vector<MatchResult>& sortedResults, double avgHomeGoals, double avgAwayGoals) {
+        teams.clear();
+        leagueAvgHomeGoals = avgHomeGoals;
+        leagueAvgAwayGoals = avgAwayGoals;
+        for (const MatchResult& result : sortedResults) addResult(result);
+    }
+
+    // Apply one more result; must not be older than anything already added
+    void addResult(const MatchResult& result) {
+        TeamRatings& home = teams[result.homeTeamName];
+        TeamRatings& away = teams[result.awayTeamName];
+        const RatingPoint h = home.current;
+        const RatingPoint a = away.current;
+
+        // --- Elo: overall, and home/away splits against the opponent's matching split ---
+        double score = result.homeGoals > result.awayGoals ? 1.0 : result.homeGoals < result.awayGoals ? 0.0 : 0.5;
+        double overallDelta = eloK * (score - expectedScore(h.elo + eloHomeAdvantage, a.elo));
+        double splitDelta = eloK * (score - expectedScore(h.homeElo + eloHomeAdvantage, a.awayElo));
+        home.current.elo = static_cast<float>(h.elo + overallDelta);
+        away.current.elo = static_cast<float>(a.elo - overallDelta);
+        home.current.homeElo = static_cast<float>(h.homeElo + splitDelta);
+        away.current.awayElo = static_cast<float>(a.awayElo - splitDelta);
+
+        // --- Goal strengths: blend in this match's goals relative to what the
+        // opponent's (pre-match) strength and the league average predicted ---
+        double homeGoalsBase = leagueAvgHomeGoals > 0.0 ? leagueAvgHomeGoals : 1.0;
+        double awayGoalsBase = leagueAvgAwayGoals > 0.0 ? leagueAvgAwayGoals : 1.0;
+        home.current.homeAttack = smooth(h.homeAttack, result.homeGoals / (floorAt(a.awayDefense) * homeGoalsBase));
+        away.current.awayDefense = smooth(a.awayDefense, result.homeGoals / (floorAt(h.homeAttack) * homeGoalsBase));
+        away.current.awayAttack = smooth(a.awayAttack, result.awayGoals / (floorAt(h.homeDefense) * awayGoalsBase));
+        home.current.homeDefense = smooth(h.homeDefense, result.awayGoals / (floorAt(a.awayAttack) * awayGoalsBase));
+
+        home.current.date = result.date;
+        away.current.date = result.date;
+        home.timeline.push_back(home.current);
+        away.timeline.push_back(away.current);
+    }
+
+    // Ratings after the team's last match strictly before 'date', or nullptr
+    const RatingPoint* ratingBefore(const std::string& teamName, std::chrono::system_clock::time_point date) const {
+        auto it = teams.find(teamName);
+        if (it == teams.end()) return nullptr;
+        const std::vector<RatingPoint>& timeline = it->second.timeline;
+        auto after = std::lower_bound(timeline.begin(), timeline.end(), date,
+                                      [](const RatingPoint& point, std::chrono::system_clock::time_point d) { return point.date < d; });
+        return after == timeline.begin() ? nullptr : &*(after - 1);
+    }
+
+    // Most recent ratings, or nullptr for a team with no results
+    const RatingPoint* latest(const std::string& teamName) const {
+        auto it = teams.find(teamName);
+        return (it == teams.end() || it->second.timeline.empty()) ? nullptr : &it->second.timeline.back();
+    }
+
+    // Overwrite the goal strengths of 'team' with its ratings as of 'date'.
+    // Corner strengths are left as they are. False if there is no prior match.
+    bool applyStrengths(const std::string& teamName, std::chrono::system_clock::time_point date, Team& team) const {
+        const RatingPoint* point = ratingBefore(teamName, date);
+        if (!point) return false;
+        team.homeAttackStrength = point->homeAttack;
+        team.homeDefenseStrength = point->homeDefense;
+        team.awayAttackStrength = point->awayAttack;
+        team.awayDefenseStrength = point->awayDefense;
+        return true;
+    }
+
+private:
+    struct TeamRatings {
+        RatingPoint current{{}, 1500.0f, 1500.0f, 1500.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+        std::vector<RatingPoint> timeline;
+    };
+
+    std::map<std::string, TeamRatings> teams;
+    double leagueAvgHomeGoals = 0.0;
+    double leagueAvgAwayGoals = 0.0;
+
+    static double expectedScore(double ratingA, double ratingB) {
+        return 1.0 / (1.0 + std::pow(10.0, (ratingB - ratingA) / 400.0));
+    }
+
+    // Keeps one weak opponent from producing a huge adjusted performance
+    static double floorAt(double strength) { return std::max(strength, 0.2); }
+
+    float smooth(double previous, double observed) const {
+        return static_cast<float>((1.0 - strengthSmoothing) * previous + strengthSmoothing * observed);
+    }
+};
+
+#endif // RATINGENGINE_H
@@ -10,7 +10,7 @@ away = input("Away team: ")
 home_goals = input("Home goals: ")
 away_goals = input("Away goals: ")
 
-row = ['TR1', date, time, home, away, home_goals, away_goals,
+row = ['T1', date, time, home, away, home_goals, away_goals,
        '', '', '', '', '', '', '', '', '', 0, 0]
 
 with open(csv_file, 'a', newline='', encoding='utf-8') as f: